@@ -19,6 +19,7 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    unsigned long long cmd_cnt;         /* Number of device commands. */
   };
 
 /* List of all block devices. */
@@ -123,6 +124,7 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
   check_sector (block, sector);
   block->ops->read (block->aux, sector, buffer);
   block->read_cnt++;
+  block->cmd_cnt++;
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -137,6 +139,65 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
   ASSERT (block->type != BLOCK_FOREIGN);
   block->ops->write (block->aux, sector, buffer);
   block->write_cnt++;
+  block->cmd_cnt++;
+}
+
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes, in as few device commands as the driver allows. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     void *buffer, block_sector_t cnt)
+{
+  uint8_t *p = buffer;
+  block_sector_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  if (block->ops->read_multiple != NULL)
+    {
+      block->ops->read_multiple (block->aux, sector, buffer, cnt);
+      block->cmd_cnt++;
+    }
+  else
+    for (i = 0; i < cnt; i++)
+      {
+        block->ops->read (block->aux, sector + i, p + i * BLOCK_SECTOR_SIZE);
+        block->cmd_cnt++;
+      }
+  block->read_cnt += cnt;
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes,
+   in as few device commands as the driver allows.  Returns after
+   the block device has acknowledged receiving the data. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      const void *buffer, block_sector_t cnt)
+{
+  const uint8_t *p = buffer;
+  block_sector_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  if (block->ops->write_multiple != NULL)
+    {
+      block->ops->write_multiple (block->aux, sector, buffer, cnt);
+      block->cmd_cnt++;
+    }
+  else
+    for (i = 0; i < cnt; i++)
+      {
+        block->ops->write (block->aux, sector + i, p + i * BLOCK_SECTOR_SIZE);
+        block->cmd_cnt++;
+      }
+  block->write_cnt += cnt;
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -171,9 +232,9 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
-          printf ("%s (%s): %llu reads, %llu writes\n",
+          printf ("%s (%s): %llu reads, %llu writes, %llu commands\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  block->read_cnt, block->write_cnt, block->cmd_cnt);
         }
     }
 }
@@ -200,6 +261,7 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->cmd_cnt = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -317,8 +317,30 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+/* Reads CNT sectors starting at SECTOR from partition P into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE bytes. */
+static void
+partition_read_multiple (void *p_, block_sector_t sector, void *buffer,
+                         block_sector_t cnt)
+{
+  struct partition *p = p_;
+  block_read_multiple (p->block, p->start + sector, buffer, cnt);
+}
+
+/* Writes CNT sectors starting at SECTOR to partition P from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes. */
+static void
+partition_write_multiple (void *p_, block_sector_t sector,
+                          const void *buffer, block_sector_t cnt)
+{
+  struct partition *p = p_;
+  block_write_multiple (p->block, p->start + sector, buffer, cnt);
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_read_multiple,
+    partition_write_multiple
   };
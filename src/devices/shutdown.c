@@ -4,8 +4,11 @@
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/highmem.h"
 #include "threads/io.h"
+#include "threads/shrinker.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
@@ -13,6 +16,19 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "devices/swap.h"
+#include "userprog/process.h"
+#include "vm/frame.h"
+#include "vm/compact.h"
+#include "vm/ksm.h"
+#include "vm/largepage.h"
+#include "vm/reclaim.h"
+#include "vm/rss.h"
+#include "vm/vmstat.h"
+#include "vm/writeback.h"
+#include "vm/zswap.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -122,6 +138,9 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  highmem_print_stats ();
+  vmalloc_print_stats ();
+  shrinker_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -130,4 +149,17 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  frame_print_stats ();
+  vmstat_print_stats ();
+  fault_around_print_stats ();
+  reclaim_print_stats ();
+  writeback_print_stats ();
+  rss_print_stats ();
+  ksm_print_stats ();
+  largepage_print_stats ();
+  compact_print_stats ();
+  swap_print_stats ();
+  zswap_print_stats ();
+#endif
 }
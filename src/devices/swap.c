@@ -1,41 +1,318 @@
 #include "devices/swap.h"
 #include "devices/block.h"
+#include "threads/highmem.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/shrinker.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "vm/zswap.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <list.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-/* Pointer to the swap device */
-static struct block *swap_device;
+/* Number of sectors needed to store a page */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Most swap devices in use at once */
+#define SWAP_DEV_MAX 8
+
+/* A swap device.  Its slots follow those of the devices before it in
+   swap_devs, so a slot number names both the device and the place on
+   it.  Slots are taken from the devices of the highest priority first,
+   going round-robin across devices of equal priority so that
+   consecutive page-outs go to different disks */
+struct swap_dev
+  {
+    struct block *block;        /* Block device */
+    int priority;               /* Higher is used first */
+    size_t base;                /* First slot on the device */
+    size_t slot_cnt;            /* Number of slots on the device */
+    size_t cursor;              /* Next-fit cursor, a slot on the device */
+    size_t used_cnt;            /* Slots in use */
+    size_t peak_cnt;            /* Most slots ever in use */
+    unsigned long long write_cnt;  /* Pages written */
+    unsigned long long read_cnt;   /* Pages read */
+    uint8_t *cluster_buf;       /* Bounce buffer for clustered transfers */
+    struct lock cluster_lock;   /* Protects cluster_buf */
+  };
+
+/* Swap devices in order of decreasing priority */
+static struct swap_dev swap_devs[SWAP_DEV_MAX];
+static size_t swap_dev_cnt;
+
+/* Devices named with -swapdev, as "BDEV" or "BDEV:PRIORITY" */
+static const char *swap_dev_specs[SWAP_DEV_MAX];
+static size_t swap_dev_spec_cnt;
+
+/* Round-robin position among devices of equal priority */
+static size_t swap_rr;
 
 /* Pointer to a bitmap to track used swap pages */
 static struct bitmap *swap_bitmap;
 
-/* Lock that protects swap_bitmap from unsynchronised access */
+/* Number of pages referring to each swap slot.  Slots are shared
+   between a forked child and its parent until one of them writes. */
+static uint16_t *swap_refs;
+
+/* Lock that protects swap_bitmap, swap_refs, the devices' cursors
+   and counts of slots in use, swap_rr and the swap cache from
+   unsynchronised access */
 static struct lock swap_lock;
 
-/* Number of sectors needed to store a page */
-#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+/* Swap cache: pages read ahead from swap that no one asked for yet.
+   A page leaves the cache when it is swapped in, when its slot is
+   freed or rewritten, or when memory runs short */
+struct swap_cache_page
+  {
+    size_t slot;                /* Slot the page was read from */
+    void *kpage;                /* Copy of the slot's contents */
+    struct list_elem elem;      /* Element in swap_cache */
+  };
+
+/* Most pages kept in the swap cache */
+#define SWAP_CACHE_MAX (4 * SWAP_CLUSTER)
+
+static struct list swap_cache;
+static size_t swap_cache_cnt;
+
+/* Number of pages written to and read from swap */
+static unsigned long long swap_write_cnt;
+static unsigned long long swap_read_cnt;
+static unsigned long long swap_readahead_cnt;
+static unsigned long long swap_cache_hit_cnt;
+
+static size_t alloc_slots (size_t cnt);
+static struct swap_cache_page *swap_cache_find (size_t slot);
+static void swap_cache_evict (struct swap_cache_page *);
+static size_t swap_cache_count (void);
+static size_t swap_cache_scan (size_t page_cnt);
+
+/* Gives swap cache pages back when the user pool runs short */
+static struct shrinker swap_cache_shrinker =
+  {
+    .name = "swap cache",
+    .pool = PAL_USER,
+    .count = swap_cache_count,
+    .scan = swap_cache_scan,
+  };
+
+/* Adds the block device named by SPEC, "BDEV" or "BDEV:PRIORITY",
+   to the swap devices set up by swap_init().  Returns false if too
+   many devices were named */
+bool
+swap_add_device (const char *spec)
+{
+  if (swap_dev_spec_cnt >= SWAP_DEV_MAX)
+    return false;
+  swap_dev_specs[swap_dev_spec_cnt++] = spec;
+  return true;
+}
+
+/* Adds BLOCK to the swap devices with PRIORITY, or just sets its
+   priority if it is there already */
+static void
+add_device (struct block *block, int priority)
+{
+  size_t i;
+
+  for (i = 0; i < swap_dev_cnt; i++)
+    if (swap_devs[i].block == block)
+      {
+        swap_devs[i].priority = priority;
+        return;
+      }
+  if (swap_dev_cnt >= SWAP_DEV_MAX)
+    PANIC ("too many swap devices");
+  if (block == block_get_role (BLOCK_KERNEL)
+      || block == block_get_role (BLOCK_FILESYS)
+      || block == block_get_role (BLOCK_SCRATCH))
+    PANIC ("%s is in use and cannot be used for swap", block_name (block));
+  swap_devs[swap_dev_cnt].block = block;
+  swap_devs[swap_dev_cnt].priority = priority;
+  swap_dev_cnt++;
+}
+
+/* Finds the devices to swap to: the swap role device, every other
+   device of swap type, and the devices named with -swapdev */
+static void
+find_devices (void)
+{
+  struct block *block;
+  size_t i;
+
+  block = block_get_role (BLOCK_SWAP);
+  if (block != NULL)
+    add_device (block, 0);
+  for (block = block_first (); block != NULL; block = block_next (block))
+    if (block_type (block) == BLOCK_SWAP)
+      add_device (block, 0);
+
+  for (i = 0; i < swap_dev_spec_cnt; i++)
+    {
+      char name[16];
+      const char *colon = strchr (swap_dev_specs[i], ':');
+      int priority = colon != NULL ? atoi (colon + 1) : 0;
+      size_t len = colon != NULL ? (size_t) (colon - swap_dev_specs[i])
+                                 : strlen (swap_dev_specs[i]);
+
+      if (len >= sizeof name)
+        len = sizeof name - 1;
+      strlcpy (name, swap_dev_specs[i], len + 1);
+      block = block_get_by_name (name);
+      if (block == NULL)
+        PANIC ("No such block device \"%s\"", name);
+      add_device (block, priority);
+    }
+}
 
 /* Sets up the swap space */
 void
 swap_init (void) 
 {
-  // locate the swap block allocated to the kernel
-  swap_device = block_get_role (BLOCK_SWAP);
-  if (swap_device == NULL) {
-      printf ("no swap device--swap disabled\n");
-      swap_bitmap = bitmap_create (0);
-  } else {
-    // create a bitmap with 1 slot per page-sized chunk of memory on the swap block
-    swap_bitmap = bitmap_create (block_size (swap_device) / PAGE_SECTORS);
-  }
-  
+  size_t slot_cnt = 0;
+  size_t i, j;
+
+  find_devices ();
+  if (swap_dev_cnt == 0)
+    printf ("no swap device--swap disabled\n");
+
+  // order the devices by decreasing priority, keeping probe order
+  // among equals, and lay out their slots one after another
+  for (i = 1; i < swap_dev_cnt; i++)
+    for (j = i; j > 0 && swap_devs[j - 1].priority < swap_devs[j].priority; j--)
+      {
+        struct swap_dev tmp = swap_devs[j];
+        swap_devs[j] = swap_devs[j - 1];
+        swap_devs[j - 1] = tmp;
+      }
+  for (i = 0; i < swap_dev_cnt; i++)
+    {
+      struct swap_dev *d = &swap_devs[i];
+      d->base = slot_cnt;
+      d->slot_cnt = block_size (d->block) / PAGE_SECTORS;
+      d->cursor = d->base;
+      d->cluster_buf = palloc_get_multiple (PAL_ASSERT, SWAP_CLUSTER);
+      lock_init (&d->cluster_lock);
+      slot_cnt += d->slot_cnt;
+      printf ("swap: using %s, %zu slots, priority %d\n",
+              block_name (d->block), d->slot_cnt, d->priority);
+    }
+
+  // create a bitmap with 1 slot per page-sized chunk of memory on the
+  // swap devices
+  swap_bitmap = bitmap_create (slot_cnt);
   if (swap_bitmap == NULL){
     PANIC ("couldn't create swap bitmap");
   }
+  swap_refs = calloc (bitmap_size (swap_bitmap) + 1, sizeof *swap_refs);
+  if (swap_refs == NULL)
+    PANIC ("couldn't create swap reference counts");
+  zswap_init (bitmap_size (swap_bitmap));
   lock_init (&swap_lock);
+  list_init (&swap_cache);
+  shrinker_register (&swap_cache_shrinker);
+}
+
+/* Returns the device holding SLOT */
+static struct swap_dev *
+slot_dev (size_t slot)
+{
+  size_t i;
+
+  for (i = 0; i < swap_dev_cnt; i++)
+    if (slot < swap_devs[i].base + swap_devs[i].slot_cnt)
+      return &swap_devs[i];
+  NOT_REACHED ();
+}
+
+/* Allocates CNT adjacent free slots on D at or after START.  Returns
+   the first, or BITMAP_ERROR if there is no such run.  Must be called
+   with swap_lock held */
+static size_t
+dev_scan (struct swap_dev *d, size_t start, size_t cnt)
+{
+  size_t slot = bitmap_scan (swap_bitmap, start, cnt, false);
+  if (slot == BITMAP_ERROR || slot + cnt > d->base + d->slot_cnt)
+    return BITMAP_ERROR;
+  bitmap_set_multiple (swap_bitmap, slot, cnt, true);
+  return slot;
+}
+
+/* Allocates CNT adjacent slots on D.  Slots are allocated next-fit
+   from the one after the last allocation, so pages evicted one after
+   another end up adjacent.  Must be called with swap_lock held */
+static size_t
+dev_alloc (struct swap_dev *d, size_t cnt)
+{
+  size_t slot = dev_scan (d, d->cursor, cnt);
+  if (slot == BITMAP_ERROR && d->cursor != d->base)
+    slot = dev_scan (d, d->base, cnt);
+  if (slot == BITMAP_ERROR)
+    return BITMAP_ERROR;
+
+  d->cursor = slot + cnt;
+  if (d->cursor >= d->base + d->slot_cnt)
+    d->cursor = d->base;
+  d->used_cnt += cnt;
+  if (d->used_cnt > d->peak_cnt)
+    d->peak_cnt = d->used_cnt;
+  return slot;
+}
+
+/* Allocates CNT adjacent swap-slots, each with one reference, and
+   returns the first, or BITMAP_ERROR if there is no such run.
+   Must be called with swap_lock held */
+static size_t
+alloc_slots (size_t cnt)
+{
+  size_t first, last, k;
+  size_t slot = BITMAP_ERROR;
+
+  // try each group of devices of equal priority in turn, starting
+  // with a different device of the group every time
+  for (first = 0; first < swap_dev_cnt && slot == BITMAP_ERROR; first = last)
+    {
+      for (last = first + 1; last < swap_dev_cnt
+           && swap_devs[last].priority == swap_devs[first].priority; last++)
+        continue;
+      for (k = 0; k < last - first && slot == BITMAP_ERROR; k++)
+        slot = dev_alloc (&swap_devs[first + (swap_rr + k) % (last - first)],
+                          cnt);
+    }
+  if (slot == BITMAP_ERROR)
+    return BITMAP_ERROR;
+  swap_rr++;
+
+  for (size_t i = 0; i < cnt; i++)
+    swap_refs[slot + i] = 1;
+  return slot;
+}
+
+/* Reads CNT pages from the slots starting at SLOT, all on one device,
+   into BUF */
+static void
+dev_read (size_t slot, void *buf, size_t cnt)
+{
+  struct swap_dev *d = slot_dev (slot);
+  block_read_multiple (d->block, (slot - d->base) * PAGE_SECTORS, buf,
+                       cnt * PAGE_SECTORS);
+  d->read_cnt += cnt;
+}
+
+/* Writes CNT pages from BUF into the slots starting at SLOT, all on
+   one device */
+static void
+dev_write (size_t slot, const void *buf, size_t cnt)
+{
+  struct swap_dev *d = slot_dev (slot);
+  block_write_multiple (d->block, (slot - d->base) * PAGE_SECTORS, buf,
+                        cnt * PAGE_SECTORS);
+  d->write_cnt += cnt;
 }
 
 /* Swaps page at VADDR out of memory, returns the swap-slot used */
@@ -44,39 +321,300 @@ swap_out (const void *vaddr)
 {
   // find available swap-slot for the page to be swapped out
   lock_acquire (&swap_lock);
-  size_t slot = bitmap_scan_and_flip (swap_bitmap, 0, 1, false);
+  size_t slot = alloc_slots (1);
   lock_release (&swap_lock);
   if (slot == BITMAP_ERROR) 
     return BITMAP_ERROR; 
 
-  // calculate block sector from swap-slot number
-  size_t sector = slot * PAGE_SECTORS;
-  
-  // loop over each sector of the page, copying it from memory into swap
-  for (size_t i = 0; i < PAGE_SECTORS; i++)
-    block_write (swap_device, sector + i, vaddr + i * BLOCK_SECTOR_SIZE);
+  swap_write (slot, vaddr);
+  return slot;
+}
 
+/* Swaps the CNT pages at PAGES out of memory into adjacent
+   swap-slots with a single device write.  Returns the slot of
+   PAGES[0]; PAGES[i] went to the slot i after it.  Returns
+   BITMAP_ERROR if there are not CNT adjacent free slots */
+size_t
+swap_out_cluster (void *const pages[], size_t cnt)
+{
+  ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+
+  lock_acquire (&swap_lock);
+  size_t slot = alloc_slots (cnt);
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return BITMAP_ERROR;
+
+  // gather the pages that do not compress into the bounce buffer and
+  // write each run of them in one go; the slots are all on one device
+  struct swap_dev *d = slot_dev (slot);
+  lock_acquire (&d->cluster_lock);
+  size_t run = 0;
+  for (size_t i = 0; i <= cnt; i++)
+    {
+      if (i < cnt)
+        {
+          void *kaddr = kmap (pages[i]);
+          bool stored = zswap_store (slot + i, kaddr);
+          if (!stored)
+            memcpy (d->cluster_buf + i * PGSIZE, kaddr, PGSIZE);
+          kunmap (kaddr);
+          if (!stored)
+            continue;
+        }
+      if (run < i)
+        dev_write (slot + run, d->cluster_buf + run * PGSIZE, i - run);
+      run = i + 1;
+    }
+  lock_release (&d->cluster_lock);
+  swap_write_cnt += cnt;
   return slot;
 }
 
+/* Writes page at VADDR into swap-slot SLOT, which the caller owns */
+void
+swap_write (size_t slot, const void *vaddr)
+{
+  // a copy read ahead earlier is now out of date
+  lock_acquire (&swap_lock);
+  struct swap_cache_page *scp = swap_cache_find (slot);
+  if (scp != NULL)
+    swap_cache_evict (scp);
+  lock_release (&swap_lock);
+
+  swap_write_cnt++;
+  void *kaddr = kmap (vaddr);
+  if (!zswap_store (slot, kaddr))
+    dev_write (slot, kaddr, 1);
+  kunmap (kaddr);
+}
+
 /* Swaps page on disk in swap-slot SLOT into memory at VADDR */
 void
 swap_in (void *vaddr, size_t slot) 
 {
-  // calculate block sector from swap-slot number
-  size_t sector = slot * PAGE_SECTORS;
+  swap_in_cluster (vaddr, slot, 1);
+}
+
+/* Swaps page on disk in swap-slot SLOT into memory at VADDR.  The
+   CNT - 1 slots after SLOT are read in the same transfer and kept in
+   the swap cache, so the caller should only ask for slots holding
+   pages it expects to fault on next */
+void
+swap_in_cluster (void *vaddr, size_t slot, size_t cnt)
+{
+  ASSERT (cnt > 0 && cnt <= SWAP_CLUSTER);
+  void *kaddr = kmap (vaddr);
 
-  // loop over each sector of the page, copying it from swap into memory
-  for (size_t i = 0; i < PAGE_SECTORS; i++)
-    block_read (swap_device, sector + i, vaddr + i * BLOCK_SECTOR_SIZE);
+  // a page that was read ahead needs no I/O at all
+  lock_acquire (&swap_lock);
+  struct swap_cache_page *scp = swap_cache_find (slot);
+  if (scp != NULL)
+    {
+      memcpy (kaddr, scp->kpage, PGSIZE);
+      swap_cache_evict (scp);
+      swap_cache_hit_cnt++;
+      cnt = 0;
+    }
+  else
+    {
+      // only read ahead up to the first slot that is cached, compressed,
+      // free or on another device
+      struct swap_dev *d = slot_dev (slot);
+      for (size_t i = 1; i < cnt; i++)
+        if (slot + i >= d->base + d->slot_cnt || swap_refs[slot + i] == 0
+            || swap_cache_find (slot + i) != NULL || zswap_contains (slot + i))
+          {
+            cnt = i;
+            break;
+          }
+    }
+  lock_release (&swap_lock);
+
+  // a compressed page is decompressed instead of read
+  if (cnt > 0 && zswap_load (slot, kaddr))
+    cnt = 0;
+
+  if (cnt == 1)
+    dev_read (slot, kaddr, 1);
+  else if (cnt > 1)
+    {
+      struct swap_dev *d = slot_dev (slot);
+      lock_acquire (&d->cluster_lock);
+      dev_read (slot, d->cluster_buf, cnt);
+      memcpy (kaddr, d->cluster_buf, PGSIZE);
+
+      lock_acquire (&swap_lock);
+      for (size_t i = 1; i < cnt && swap_refs[slot + i] > 0; i++)
+        {
+          if (swap_cache_cnt >= SWAP_CACHE_MAX)
+            swap_cache_evict (list_entry (list_front (&swap_cache),
+                                          struct swap_cache_page, elem));
+          scp = malloc (sizeof *scp);
+          if (scp == NULL)
+            break;
+          scp->kpage = palloc_get_page (PAL_USER);
+          if (scp->kpage == NULL)
+            {
+              free (scp);
+              break;
+            }
+          scp->slot = slot + i;
+          memcpy (scp->kpage, d->cluster_buf + i * PGSIZE, PGSIZE);
+          list_push_back (&swap_cache, &scp->elem);
+          swap_cache_cnt++;
+          swap_readahead_cnt++;
+        }
+      lock_release (&swap_lock);
+      lock_release (&d->cluster_lock);
+    }
+  swap_read_cnt++;
+  kunmap (kaddr);
   
-  // clear the swap-slot previously used by this page
+  // release this page's reference to the swap-slot
   swap_drop (slot);
 }
 
-/* Clears the swap-slot SLOT so that it can be used for another page */
+/* Returns the swap cache page of SLOT, or NULL if it is not cached.
+   Must be called with swap_lock held */
+static struct swap_cache_page *
+swap_cache_find (size_t slot)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&swap_cache); e != list_end (&swap_cache);
+       e = list_next (e))
+    {
+      struct swap_cache_page *scp = list_entry (e, struct swap_cache_page, elem);
+      if (scp->slot == slot)
+        return scp;
+    }
+  return NULL;
+}
+
+/* Removes SCP from the swap cache and frees it.
+   Must be called with swap_lock held */
+static void
+swap_cache_evict (struct swap_cache_page *scp)
+{
+  list_remove (&scp->elem);
+  swap_cache_cnt--;
+  palloc_free_page (scp->kpage);
+  free (scp);
+}
+
+/* Returns the number of pages in the swap cache */
+static size_t
+swap_cache_count (void)
+{
+  return swap_cache_cnt;
+}
+
+/* Frees up to PAGE_CNT of the oldest pages of the swap cache, unless
+   swap_lock is busy.  The pages are freed after swap_lock is
+   released, so that no allocator lock is taken under it.  Returns
+   the number of pages freed */
+static size_t
+swap_cache_scan (size_t page_cnt)
+{
+  struct list victims;
+  size_t freed = 0;
+
+  if (!shrinker_try_lock (&swap_lock))
+    return 0;
+  list_init (&victims);
+  for (; freed < page_cnt && !list_empty (&swap_cache); freed++)
+    {
+      list_push_back (&victims, list_pop_front (&swap_cache));
+      swap_cache_cnt--;
+    }
+  lock_release (&swap_lock);
+
+  while (!list_empty (&victims))
+    {
+      struct swap_cache_page *scp = list_entry (list_pop_front (&victims),
+                                                struct swap_cache_page, elem);
+      palloc_free_page (scp->kpage);
+      free (scp);
+    }
+  return freed;
+}
+
+/* Adds a reference to swap-slot SLOT, for a page that now shares it */
+void
+swap_dup (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (swap_refs[slot] > 0);
+  swap_refs[slot]++;
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to swap-slot SLOT.  Must be called with swap_lock
+   held */
+static void
+drop_slot (size_t slot)
+{
+  ASSERT (swap_refs[slot] > 0);
+  if (--swap_refs[slot] == 0)
+    {
+      struct swap_cache_page *scp = swap_cache_find (slot);
+      if (scp != NULL)
+        swap_cache_evict (scp);
+      zswap_invalidate (slot);
+      bitmap_reset (swap_bitmap, slot);
+      slot_dev (slot)->used_cnt--;
+    }
+}
+
+/* Drops a reference to swap-slot SLOT, clearing it so that it can be
+   used for another page once no page refers to it */
 void
 swap_drop (size_t slot)
 {
-  bitmap_reset (swap_bitmap, slot);
+  lock_acquire (&swap_lock);
+  drop_slot (slot);
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to each of the CNT swap-slots in SLOTS, taking
+   swap_lock only once */
+void
+swap_drop_batch (const size_t slots[], size_t cnt)
+{
+  if (cnt == 0)
+    return;
+  lock_acquire (&swap_lock);
+  for (size_t i = 0; i < cnt; i++)
+    drop_slot (slots[i]);
+  lock_release (&swap_lock);
+}
+
+/* Returns the number of swap slots in use on all devices */
+size_t
+swap_used_cnt (void)
+{
+  size_t cnt = 0;
+
+  for (size_t i = 0; i < swap_dev_cnt; i++)
+    cnt += swap_devs[i].used_cnt;
+  return cnt;
+}
+
+/* Prints swap statistics */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %llu pages written, %llu pages read, "
+          "%llu read ahead, %llu swap cache hits\n",
+          swap_write_cnt, swap_read_cnt,
+          swap_readahead_cnt, swap_cache_hit_cnt);
+  for (size_t i = 0; i < swap_dev_cnt; i++)
+    {
+      struct swap_dev *d = &swap_devs[i];
+      printf ("Swap %s: priority %d, %zu of %zu slots used, %zu peak, "
+              "%llu pages written, %llu pages read\n",
+              block_name (d->block), d->priority, d->used_cnt, d->slot_cnt,
+              d->peak_cnt, d->write_cnt, d->read_cnt);
+    }
 }
@@ -1,11 +1,23 @@
 #ifndef DEVICES_SWAP_H
 #define DEVICES_SWAP_H 1
 
+#include <stdbool.h>
 #include <stddef.h>
 
+/* Most pages moved to or from swap in one batched transfer */
+#define SWAP_CLUSTER 8
+
+bool swap_add_device (const char *spec);
 void swap_init (void);
 size_t swap_out (const void *vaddr);
+size_t swap_out_cluster (void *const pages[], size_t cnt);
+void swap_write (size_t slot, const void *vaddr);
 void swap_in (void *vaddr, size_t slot);
+void swap_in_cluster (void *vaddr, size_t slot, size_t cnt);
+void swap_dup (size_t slot);
 void swap_drop (size_t slot);
+void swap_drop_batch (const size_t slots[], size_t cnt);
+size_t swap_used_cnt (void);
+void swap_print_stats (void);
 
 #endif /* devices/swap.h */
@@ -0,0 +1,317 @@
+/* Balanced binary search tree.
+
+   See avl.h for basic information. */
+
+#include "avl.h"
+#include "../debug.h"
+
+static struct avl_elem *insert_node (struct avl *, struct avl_elem *,
+                                     struct avl_elem *,
+                                     struct avl_elem **);
+static struct avl_elem *delete_node (struct avl *, struct avl_elem *,
+                                     struct avl_elem *,
+                                     struct avl_elem **);
+static struct avl_elem *rebalance (struct avl_elem *);
+
+/* Initializes tree T to compare elements using LESS, given
+   auxiliary data AUX. */
+void
+avl_init (struct avl *t, avl_less_func *less, void *aux)
+{
+  t->root = NULL;
+  t->elem_cnt = 0;
+  t->less = less;
+  t->aux = aux;
+}
+
+/* Calls DESTRUCTOR on every element of the subtree at NODE,
+   children before their parent. */
+static void
+clear_node (struct avl_elem *node, avl_action_func *destructor, void *aux)
+{
+  if (node == NULL)
+    return;
+  clear_node (node->left, destructor, aux);
+  clear_node (node->right, destructor, aux);
+  if (destructor != NULL)
+    destructor (node, aux);
+}
+
+/* Removes all the elements from T.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the tree.  DESTRUCTOR may, if appropriate, deallocate the
+   memory used by the tree element.  Modifying T while
+   avl_clear() is running yields undefined behavior. */
+void
+avl_clear (struct avl *t, avl_action_func *destructor)
+{
+  clear_node (t->root, destructor, t->aux);
+  t->root = NULL;
+  t->elem_cnt = 0;
+}
+
+/* Inserts NEW into tree T and returns a null pointer, if no
+   equal element is already in the tree.
+   If an equal element is already in the tree, returns it
+   without inserting NEW. */
+struct avl_elem *
+avl_insert (struct avl *t, struct avl_elem *new)
+{
+  struct avl_elem *old = NULL;
+
+  new->left = new->right = NULL;
+  new->height = 1;
+  t->root = insert_node (t, t->root, new, &old);
+  if (old == NULL)
+    t->elem_cnt++;
+  return old;
+}
+
+/* Finds and returns an element equal to E in tree T, or a null
+   pointer if no equal element exists in the tree. */
+struct avl_elem *
+avl_find (struct avl *t, const struct avl_elem *e)
+{
+  struct avl_elem *node = t->root;
+
+  while (node != NULL)
+    if (t->less (e, node, t->aux))
+      node = node->left;
+    else if (t->less (node, e, t->aux))
+      node = node->right;
+    else
+      return node;
+  return NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in tree T.
+   Returns a null pointer if no equal element existed in the
+   tree. */
+struct avl_elem *
+avl_delete (struct avl *t, struct avl_elem *e)
+{
+  struct avl_elem *found = NULL;
+
+  t->root = delete_node (t, t->root, e, &found);
+  if (found != NULL)
+    t->elem_cnt--;
+  return found;
+}
+
+/* Returns the greatest element of tree T that is less than or
+   equal to E, or a null pointer if there is none. */
+struct avl_elem *
+avl_floor (struct avl *t, const struct avl_elem *e)
+{
+  struct avl_elem *node = t->root;
+  struct avl_elem *best = NULL;
+
+  while (node != NULL)
+    if (t->less (e, node, t->aux))
+      node = node->left;
+    else
+      {
+        best = node;
+        node = node->right;
+      }
+  return best;
+}
+
+/* Returns the least element of tree T that is greater than or
+   equal to E, or a null pointer if there is none. */
+struct avl_elem *
+avl_ceiling (struct avl *t, const struct avl_elem *e)
+{
+  struct avl_elem *node = t->root;
+  struct avl_elem *best = NULL;
+
+  while (node != NULL)
+    if (t->less (node, e, t->aux))
+      node = node->right;
+    else
+      {
+        best = node;
+        node = node->left;
+      }
+  return best;
+}
+
+/* Returns the least element of tree T, or a null pointer if T
+   is empty. */
+struct avl_elem *
+avl_first (struct avl *t)
+{
+  struct avl_elem *node = t->root;
+
+  if (node != NULL)
+    while (node->left != NULL)
+      node = node->left;
+  return node;
+}
+
+/* Returns the least element of tree T that is greater than E,
+   or a null pointer if there is none.  E need not be in T.
+   Together with avl_first() this walks T in order; unlike the
+   hash table's iterator, T may be modified between steps. */
+struct avl_elem *
+avl_next (struct avl *t, const struct avl_elem *e)
+{
+  struct avl_elem *node = t->root;
+  struct avl_elem *best = NULL;
+
+  while (node != NULL)
+    if (t->less (e, node, t->aux))
+      {
+        best = node;
+        node = node->left;
+      }
+    else
+      node = node->right;
+  return best;
+}
+
+/* Returns the number of elements in T. */
+size_t
+avl_size (struct avl *t)
+{
+  return t->elem_cnt;
+}
+
+/* Returns true if T contains no elements, false otherwise. */
+bool
+avl_empty (struct avl *t)
+{
+  return t->elem_cnt == 0;
+}
+
+/* Returns the height of the subtree at NODE. */
+static int
+height (const struct avl_elem *node)
+{
+  return node != NULL ? node->height : 0;
+}
+
+/* Recomputes NODE's height from its children's. */
+static void
+update_height (struct avl_elem *node)
+{
+  int l = height (node->left), r = height (node->right);
+  node->height = (l > r ? l : r) + 1;
+}
+
+/* Rotates the subtree at NODE to the right and returns its new
+   root, NODE's left child. */
+static struct avl_elem *
+rotate_right (struct avl_elem *node)
+{
+  struct avl_elem *pivot = node->left;
+
+  node->left = pivot->right;
+  pivot->right = node;
+  update_height (node);
+  update_height (pivot);
+  return pivot;
+}
+
+/* Rotates the subtree at NODE to the left and returns its new
+   root, NODE's right child. */
+static struct avl_elem *
+rotate_left (struct avl_elem *node)
+{
+  struct avl_elem *pivot = node->right;
+
+  node->right = pivot->left;
+  pivot->left = node;
+  update_height (node);
+  update_height (pivot);
+  return pivot;
+}
+
+/* Restores the balance of the subtree at NODE, whose children
+   are balanced and differ in height by at most two, and returns
+   its new root. */
+static struct avl_elem *
+rebalance (struct avl_elem *node)
+{
+  int balance = height (node->left) - height (node->right);
+
+  if (balance > 1)
+    {
+      if (height (node->left->left) < height (node->left->right))
+        node->left = rotate_left (node->left);
+      return rotate_right (node);
+    }
+  else if (balance < -1)
+    {
+      if (height (node->right->right) < height (node->right->left))
+        node->right = rotate_right (node->right);
+      return rotate_left (node);
+    }
+  update_height (node);
+  return node;
+}
+
+/* Inserts NEW into the subtree of T at NODE and returns the
+   subtree's new root.  If an equal element is found, stores it in
+   *OLD and leaves the subtree as it was. */
+static struct avl_elem *
+insert_node (struct avl *t, struct avl_elem *node, struct avl_elem *new,
+             struct avl_elem **old)
+{
+  if (node == NULL)
+    return new;
+  if (t->less (new, node, t->aux))
+    node->left = insert_node (t, node->left, new, old);
+  else if (t->less (node, new, t->aux))
+    node->right = insert_node (t, node->right, new, old);
+  else
+    {
+      *old = node;
+      return node;
+    }
+  return rebalance (node);
+}
+
+/* Removes the least element from the subtree at NODE, storing it
+   in *MIN, and returns the subtree's new root. */
+static struct avl_elem *
+delete_min (struct avl_elem *node, struct avl_elem **min)
+{
+  if (node->left == NULL)
+    {
+      *min = node;
+      return node->right;
+    }
+  node->left = delete_min (node->left, min);
+  return rebalance (node);
+}
+
+/* Removes the element equal to E from the subtree of T at NODE,
+   storing it in *FOUND, and returns the subtree's new root. */
+static struct avl_elem *
+delete_node (struct avl *t, struct avl_elem *node, struct avl_elem *e,
+             struct avl_elem **found)
+{
+  if (node == NULL)
+    return NULL;
+  if (t->less (e, node, t->aux))
+    node->left = delete_node (t, node->left, e, found);
+  else if (t->less (node, e, t->aux))
+    node->right = delete_node (t, node->right, e, found);
+  else
+    {
+      struct avl_elem *successor;
+
+      *found = node;
+      if (node->left == NULL)
+        return node->right;
+      if (node->right == NULL)
+        return node->left;
+      node->right = delete_min (node->right, &successor);
+      successor->left = node->left;
+      successor->right = node->right;
+      node = successor;
+    }
+  return rebalance (node);
+}
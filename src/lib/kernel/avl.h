@@ -0,0 +1,76 @@
+#ifndef __LIB_KERNEL_AVL_H
+#define __LIB_KERNEL_AVL_H
+
+/* Balanced binary search tree.
+
+   An AVL tree keeps the heights of the two subtrees of every node
+   within one of each other, so that search, insertion and deletion
+   all take O(log n) time.  Besides exact lookups it answers
+   ordered queries: the greatest element not above a key, the least
+   element not below it, and the element after a given one.
+
+   Like the hash table, the tree does not allocate memory.  Each
+   structure that can be in a tree embeds a struct avl_elem, and
+   avl_entry converts a struct avl_elem back to the structure that
+   contains it.  Keys must be unique within a tree. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct avl_elem
+  {
+    struct avl_elem *left;      /* Subtree of lesser elements. */
+    struct avl_elem *right;     /* Subtree of greater elements. */
+    int height;                 /* Height of the subtree rooted here. */
+  };
+
+/* Converts pointer to tree element AVL_ELEM into a pointer to
+   the structure that AVL_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the tree element. */
+#define avl_entry(AVL_ELEM, STRUCT, MEMBER)                     \
+        ((STRUCT *) ((uint8_t *) &(AVL_ELEM)->left              \
+                     - offsetof (STRUCT, MEMBER.left)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool avl_less_func (const struct avl_elem *a,
+                            const struct avl_elem *b,
+                            void *aux);
+
+/* Performs some operation on tree element E, given auxiliary
+   data AUX. */
+typedef void avl_action_func (struct avl_elem *e, void *aux);
+
+/* AVL tree. */
+struct avl
+  {
+    struct avl_elem *root;      /* Root, or a null pointer if empty. */
+    size_t elem_cnt;            /* Number of elements in tree. */
+    avl_less_func *less;        /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Basic life cycle. */
+void avl_init (struct avl *, avl_less_func *, void *aux);
+void avl_clear (struct avl *, avl_action_func *);
+
+/* Search, insertion, deletion. */
+struct avl_elem *avl_insert (struct avl *, struct avl_elem *);
+struct avl_elem *avl_find (struct avl *, const struct avl_elem *);
+struct avl_elem *avl_delete (struct avl *, struct avl_elem *);
+
+/* Ordered queries. */
+struct avl_elem *avl_floor (struct avl *, const struct avl_elem *);
+struct avl_elem *avl_ceiling (struct avl *, const struct avl_elem *);
+struct avl_elem *avl_first (struct avl *);
+struct avl_elem *avl_next (struct avl *, const struct avl_elem *);
+
+/* Information. */
+size_t avl_size (struct avl *);
+bool avl_empty (struct avl *);
+
+#endif /* lib/kernel/avl.h */
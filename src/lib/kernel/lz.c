@@ -0,0 +1,161 @@
+#include "lz.h"
+#include <debug.h>
+#include <string.h>
+
+/* Encoding.  A control byte below 32 starts a run of that many
+   plus one literal bytes.  Otherwise its top 3 bits hold the
+   match length minus 2, with 7 meaning that the next byte adds
+   to it, and its low 5 bits hold the top of the match distance
+   minus 1, whose low byte follows. */
+#define MAX_LIT 32                      /* Longest literal run. */
+#define MIN_MATCH 3                     /* Shortest back-reference. */
+#define MAX_MATCH (7 + 255 + 2)         /* Longest back-reference. */
+#define MAX_DIST (1 << 13)              /* Farthest back-reference. */
+
+/* Hashes the 3 bytes at P into the match-finding hash table. */
+static inline unsigned
+hash3 (const uint8_t *p)
+{
+  uint32_t v = ((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2];
+  return (v * 2654435761u) >> 22 & (LZ_HTAB_SIZE - 1);
+}
+
+/* Compresses the IN_LEN bytes at IN into the OUT_LEN bytes at OUT,
+   using HTAB as scratch space.  Returns the compressed size, or 0
+   if the output would not fit into OUT_LEN bytes. */
+size_t
+lz_compress (const void *in_, size_t in_len, void *out_, size_t out_len,
+             uint16_t htab[LZ_HTAB_SIZE])
+{
+  const uint8_t *in = in_;
+  const uint8_t *ip = in;
+  const uint8_t *in_end = in + in_len;
+  uint8_t *out = out_;
+  uint8_t *op = out;
+  uint8_t *out_end = out + out_len;
+  uint8_t *lit_ctrl;                    /* Control byte of current run. */
+  size_t lit = 0;                       /* Length of current run. */
+
+  ASSERT (in_len < UINT16_MAX);
+
+  /* Table entries are positions plus 1, so 0 means empty. */
+  memset (htab, 0, LZ_HTAB_SIZE * sizeof *htab);
+
+  if (op >= out_end)
+    return 0;
+  lit_ctrl = op++;
+  while (ip < in_end)
+    {
+      if (ip + MIN_MATCH <= in_end)
+        {
+          unsigned h = hash3 (ip);
+          const uint8_t *ref = htab[h] != 0 ? in + htab[h] - 1 : NULL;
+          htab[h] = ip - in + 1;
+
+          if (ref != NULL && ip - ref <= MAX_DIST
+              && ref[0] == ip[0] && ref[1] == ip[1] && ref[2] == ip[2])
+            {
+              size_t max = in_end - ip < MAX_MATCH ? in_end - ip : MAX_MATCH;
+              size_t len = MIN_MATCH;
+              size_t dist = ip - ref - 1;
+              while (len < max && ref[len] == ip[len])
+                len++;
+
+              /* Close the literal run, dropping its control byte
+                 if it is empty. */
+              if (lit == 0)
+                op--;
+              else
+                *lit_ctrl = lit - 1;
+
+              if (op + 3 > out_end)
+                return 0;
+              if (len - 2 < 7)
+                *op++ = ((len - 2) << 5) | (dist >> 8);
+              else
+                {
+                  *op++ = (7 << 5) | (dist >> 8);
+                  *op++ = len - 2 - 7;
+                }
+              *op++ = dist;
+              ip += len;
+
+              if (op >= out_end)
+                return 0;
+              lit_ctrl = op++;
+              lit = 0;
+              continue;
+            }
+        }
+
+      if (op >= out_end)
+        return 0;
+      *op++ = *ip++;
+      if (++lit == MAX_LIT)
+        {
+          *lit_ctrl = lit - 1;
+          if (op >= out_end)
+            return 0;
+          lit_ctrl = op++;
+          lit = 0;
+        }
+    }
+
+  if (lit == 0)
+    op--;
+  else
+    *lit_ctrl = lit - 1;
+  return op - out;
+}
+
+/* Decompresses the IN_LEN bytes at IN into the OUT_LEN bytes at
+   OUT.  Returns the decompressed size, or 0 if the input is
+   corrupt or does not fit into OUT_LEN bytes. */
+size_t
+lz_decompress (const void *in_, size_t in_len, void *out_, size_t out_len)
+{
+  const uint8_t *ip = in_;
+  const uint8_t *in_end = ip + in_len;
+  uint8_t *out = out_;
+  uint8_t *op = out;
+  uint8_t *out_end = out + out_len;
+
+  while (ip < in_end)
+    {
+      unsigned ctrl = *ip++;
+      size_t len;
+
+      if (ctrl < MAX_LIT)
+        {
+          len = ctrl + 1;
+          if ((size_t) (in_end - ip) < len || (size_t) (out_end - op) < len)
+            return 0;
+          memcpy (op, ip, len);
+          op += len;
+          ip += len;
+        }
+      else
+        {
+          const uint8_t *ref;
+
+          len = ctrl >> 5;
+          if (len == 7)
+            {
+              if (ip >= in_end)
+                return 0;
+              len += *ip++;
+            }
+          len += 2;
+          if (ip >= in_end)
+            return 0;
+          ref = op - (((ctrl & 0x1f) << 8) | *ip++) - 1;
+          if (ref < out || (size_t) (out_end - op) < len)
+            return 0;
+
+          /* Byte by byte: the match may overlap its own output. */
+          while (len-- > 0)
+            *op++ = *ref++;
+        }
+    }
+  return op - out;
+}
@@ -0,0 +1,20 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* LZ77 compression in the LZF format: short literal runs and
+   back-references of up to 264 bytes within the last 8 kB.  Fast
+   rather than tight, for compressing pages on the fly. */
+
+/* Number of entries of the match-finding hash table that the
+   caller provides to lz_compress(). */
+#define LZ_HTAB_SIZE 1024
+
+size_t lz_compress (const void *in, size_t in_len, void *out, size_t out_len,
+                    uint16_t htab[LZ_HTAB_SIZE]);
+size_t lz_decompress (const void *in, size_t in_len, void *out,
+                      size_t out_len);
+
+#endif /* lib/kernel/lz.h */
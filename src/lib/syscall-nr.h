@@ -23,6 +23,13 @@ enum
     SYS_MMAP,                   /* Map a file into memory. */
     SYS_MUNMAP,                 /* Remove a memory mapping. */
 
+    /* Virtual memory extensions. */
+    SYS_FORK,                   /* Clone this process copy-on-write. */
+    SYS_MADVISE,                /* Advise how memory will be used. */
+    SYS_MSYNC,                  /* Write back a memory mapping. */
+    SYS_VMSTAT,                 /* Read virtual memory statistics. */
+    SYS_BRK,                    /* Move the end of the heap. */
+
     /* Task 4 only. */
     SYS_CHDIR,                  /* Change the current directory. */
     SYS_MKDIR,                  /* Create a directory. */
@@ -1,4 +1,5 @@
 #include <syscall.h>
+#include <stddef.h>
 #include "../syscall-nr.h"
 
 /* Invokes syscall NUMBER, passing no arguments, and returns the
@@ -153,6 +154,51 @@ munmap (mapid_t mapid)
   syscall1 (SYS_MUNMAP, mapid);
 }
 
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+int
+madvise (void *addr, unsigned length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+msync (void *addr, unsigned length, int flags)
+{
+  return syscall3 (SYS_MSYNC, addr, length, flags);
+}
+
+int
+vmstat (int which, struct vmstat *stats)
+{
+  return syscall2 (SYS_VMSTAT, which, stats);
+}
+
+void *
+brk (void *addr)
+{
+  return (void *) syscall1 (SYS_BRK, addr);
+}
+
+/* Moves the program break by INCREMENT bytes and returns the old
+   break, or (void *) -1 if the heap cannot be moved that far. */
+void *
+sbrk (intptr_t increment)
+{
+  uint8_t *old_brk = brk (NULL);
+  uint8_t *new_brk = old_brk + increment;
+
+  if ((increment > 0 && new_brk < old_brk)
+      || (increment < 0 && new_brk > old_brk)
+      || (increment != 0 && brk (new_brk) != new_brk))
+    return (void *) -1;
+  return old_brk;
+}
+
 bool
 chdir (const char *dir)
 {
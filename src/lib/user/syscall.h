@@ -2,7 +2,9 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
+#include <vmstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +14,21 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access; don't read ahead. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access; read ahead. */
+#define MADV_WILLNEED 3         /* Expect access soon; bring pages in. */
+#define MADV_DONTNEED 4         /* Don't expect access; drop pages now. */
+
+/* Flags for msync(). */
+#define MS_ASYNC 1              /* Start writing back; don't wait. */
+#define MS_SYNC 4               /* Write back before returning. */
+
+/* Statistics read by vmstat(). */
+#define VMSTAT_SELF 0           /* This process's. */
+#define VMSTAT_ALL 1            /* The whole system's. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -40,6 +57,14 @@ void close (int fd);
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
 
+/* Virtual memory extensions. */
+pid_t fork (void);
+int madvise (void *addr, unsigned length, int advice);
+int msync (void *addr, unsigned length, int flags);
+int vmstat (int which, struct vmstat *stats);
+void *brk (void *addr);
+void *sbrk (intptr_t increment);
+
 /* Task 4 only. */
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
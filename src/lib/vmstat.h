@@ -0,0 +1,40 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory events, counted for the whole system and for each
+   process. */
+enum vm_event
+  {
+    /* Page faults, by how they were served. */
+    VM_FAULT_FILE,              /* Page read from its file. */
+    VM_FAULT_ZERO,              /* Page filled with zeros. */
+    VM_FAULT_SWAP,              /* Page read back from swap. */
+    VM_FAULT_STACK,             /* Stack grown by a page. */
+    VM_FAULT_SHARED,            /* Page found in the page cache. */
+    VM_FAULT_PROT,              /* Write to a copy-on-write page. */
+
+    /* Evictions, by what it took to free the frame. */
+    VM_EVICT_CLEAN,             /* Dropped without any write. */
+    VM_EVICT_SWAP,              /* Written to swap. */
+    VM_EVICT_FILE,              /* Written back to its file. */
+
+    VM_CLOCK_WRAP,              /* Clock hand went round the frame table. */
+
+    VM_EVENT_CNT                /* Number of events. */
+  };
+
+/* Fault service latency histogram.  Bucket I counts the faults served
+   in fewer than 2**(I + VMSTAT_LAT_SHIFT) CPU cycles, the last bucket
+   counting all slower ones. */
+#define VMSTAT_LAT_SHIFT 10
+#define VMSTAT_LAT_BUCKETS 12
+
+/* Virtual memory statistics, as returned by vmstat(). */
+struct vmstat
+  {
+    unsigned long long events[VM_EVENT_CNT];      /* Count of each event. */
+    unsigned long long fault_lat[VMSTAT_LAT_BUCKETS]; /* Fault latencies. */
+    unsigned swap_used;         /* Swap slots in use, system wide. */
+  };
+
+#endif /* lib/vmstat.h */
@@ -0,0 +1,37 @@
+/* Forks a child that writes to data shared copy-on-write with
+   its parent, and verifies that neither process sees the other's
+   writes. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  memset (buf, 'p', SIZE);
+  child = fork ();
+  if (child == 0)
+    {
+      /* Child: sees the parent's data, then overwrites it. */
+      for (i = 0; i < SIZE; i++)
+        if (buf[i] != 'p')
+          fail ("child read byte %zu as %02hhx", i, buf[i]);
+      memset (buf, 'c', SIZE);
+      exit (81);
+    }
+
+  CHECK (child != PID_ERROR, "fork");
+  CHECK (wait (child) == 81, "wait for child");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 'p')
+      fail ("child's write to byte %zu is visible in parent", i);
+}
@@ -0,0 +1,72 @@
+/* Grows the heap with sbrk() and checks that the new memory reads as
+   zeros and that the break moves back, then allocates, resizes and
+   frees blocks of many sizes with malloc(), and checks that freeing
+   them all gives the heap back. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define HEAP_PAGES 64
+#define BLOCKS 256
+
+static char *blocks[BLOCKS];
+
+/* Returns the size of block I. */
+static size_t
+block_size (size_t i)
+{
+  return (i * 997) % (3 * PAGE) + 1;
+}
+
+void
+test_main (void)
+{
+  char *base, *p;
+  size_t i, j;
+
+  base = sbrk (0);
+  CHECK (sbrk (HEAP_PAGES * PAGE) == base, "sbrk %d pages", HEAP_PAGES);
+  for (p = base; p < base + HEAP_PAGES * PAGE; p++)
+    if (*p != 0)
+      fail ("byte %d of new heap != 0", (int) (p - base));
+  memset (base, 0x5a, HEAP_PAGES * PAGE);
+  CHECK (sbrk (-HEAP_PAGES * PAGE) == base + HEAP_PAGES * PAGE,
+         "sbrk back");
+  CHECK (sbrk (0) == base, "break restored");
+  CHECK (sbrk (-PAGE) == (void *) -1, "sbrk below heap start");
+
+  msg ("malloc");
+  for (i = 0; i < BLOCKS; i++)
+    {
+      blocks[i] = malloc (block_size (i));
+      if (blocks[i] == NULL)
+        fail ("malloc of %zu bytes failed", block_size (i));
+      memset (blocks[i], i, block_size (i));
+    }
+
+  msg ("free odd blocks, realloc even blocks");
+  for (i = 1; i < BLOCKS; i += 2)
+    {
+      free (blocks[i]);
+      blocks[i] = NULL;
+    }
+  for (i = 0; i < BLOCKS; i += 2)
+    {
+      blocks[i] = realloc (blocks[i], 2 * block_size (i));
+      if (blocks[i] == NULL)
+        fail ("realloc failed");
+      for (j = 0; j < block_size (i); j++)
+        if (blocks[i][j] != (char) i)
+          fail ("block %zu byte %zu corrupted", i, j);
+    }
+
+  msg ("free all");
+  for (i = 0; i < BLOCKS; i++)
+    free (blocks[i]);
+  if (sbrk (0) != base)
+    fail ("heap not given back after freeing everything");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(heap) begin
+(heap) sbrk 64 pages
+(heap) sbrk back
+(heap) break restored
+(heap) sbrk below heap start
+(heap) malloc
+(heap) free odd blocks, realloc even blocks
+(heap) free all
+(heap) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Gives madvise() hints for data pages and a file mapping, checks
+   that MADV_DONTNEED turns written data pages back into zeros, and
+   that bad arguments are refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define PAGES 16
+
+static char buf[PAGES * PAGE] __attribute__ ((aligned (PAGE)));
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  int handle;
+  mapid_t map;
+  size_t i;
+
+  memset (buf, 0x5a, sizeof buf);
+  CHECK (madvise (buf, PAGES / 2 * PAGE, MADV_DONTNEED) == 0,
+         "madvise MADV_DONTNEED");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (i < PAGES / 2 * PAGE ? 0 : 0x5a))
+      fail ("byte %zu has wrong value", i);
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, actual)) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK (madvise (actual, PAGE, MADV_SEQUENTIAL) == 0, "madvise MADV_SEQUENTIAL");
+  CHECK (madvise (actual, PAGE, MADV_WILLNEED) == 0, "madvise MADV_WILLNEED");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file reported bad data");
+  CHECK (madvise (actual, PAGE, MADV_RANDOM) == 0, "madvise MADV_RANDOM");
+  CHECK (madvise (actual, PAGE, MADV_DONTNEED) == 0, "madvise MADV_DONTNEED");
+  if (memcmp (actual, sample, strlen (sample)))
+    fail ("read of mmap'd file after MADV_DONTNEED reported bad data");
+
+  CHECK (madvise (actual + 1, PAGE, MADV_NORMAL) == -1, "madvise misaligned");
+  CHECK (madvise (actual + PAGE, PAGE, MADV_NORMAL) == -1, "madvise unmapped");
+  CHECK (madvise (actual, PAGE, 99) == -1, "madvise bad advice");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) madvise MADV_DONTNEED
+(madvise) open "sample.txt"
+(madvise) mmap "sample.txt"
+(madvise) madvise MADV_SEQUENTIAL
+(madvise) madvise MADV_WILLNEED
+(madvise) madvise MADV_RANDOM
+(madvise) madvise MADV_DONTNEED
+(madvise) madvise misaligned
+(madvise) madvise unmapped
+(madvise) madvise bad advice
+(madvise) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Writes to a file mapping, checks that msync(MS_SYNC) makes the
+   change visible through read() while the mapping is still in place,
+   and that bad arguments are refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+static const char overwrite[] = "msync was here";
+
+void
+test_main (void)
+{
+  char *actual = (char *) 0x10000000;
+  char buf[sizeof sample];
+  size_t size = strlen (sample);
+  int handle;
+  mapid_t map;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, actual)) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (actual, overwrite, strlen (overwrite));
+  CHECK (msync (actual, size, MS_SYNC) == 0, "msync MS_SYNC");
+
+  seek (handle, 0);
+  CHECK (read (handle, buf, size) == (int) size, "read \"sample.txt\"");
+  if (memcmp (buf, overwrite, strlen (overwrite))
+      || memcmp (buf + strlen (overwrite), sample + strlen (overwrite),
+                 size - strlen (overwrite)))
+    fail ("read of msync'd file reported bad data");
+
+  actual[size - 1] = sample[size - 1];
+  CHECK (msync (actual, PAGE, MS_ASYNC) == 0, "msync MS_ASYNC");
+
+  CHECK (msync (actual + 1, PAGE, MS_SYNC) == -1, "msync misaligned");
+  CHECK (msync (actual + PAGE, PAGE, MS_SYNC) == -1, "msync unmapped");
+  CHECK (msync (actual, PAGE, MS_SYNC | MS_ASYNC) == -1, "msync bad flags");
+
+  munmap (map);
+  close (handle);
+}
@@ -0,0 +1,32 @@
+/* Reads 4 MB of never written memory, more than fits in the user
+   pool, then writes a byte to every 64th page and verifies that
+   only those bytes changed. */
+
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 1024 * 1024)
+#define PAGE 4096
+#define STRIDE (64 * PAGE)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu != 0", i);
+
+  msg ("sparse write pass");
+  for (i = 0; i < SIZE; i += STRIDE)
+    buf[i] = 0x5a;
+
+  msg ("read pass");
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (i % STRIDE == 0 ? 0x5a : 0))
+      fail ("byte %zu has wrong value", i);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-zero) begin
+(page-zero) read pass
+(page-zero) sparse write pass
+(page-zero) read pass
+(page-zero) end
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Touches fresh pages of zeros and grows the stack, and checks that
+   vmstat() counted the faults for this process and for the system,
+   and that a bad selector is refused. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define PAGES 16
+
+static char zeros[PAGES * PAGE];
+
+/* Returns the number of faults counted in STATS. */
+static unsigned long long
+fault_cnt (const struct vmstat *stats)
+{
+  return stats->events[VM_FAULT_FILE] + stats->events[VM_FAULT_ZERO]
+         + stats->events[VM_FAULT_SWAP] + stats->events[VM_FAULT_STACK]
+         + stats->events[VM_FAULT_SHARED] + stats->events[VM_FAULT_PROT];
+}
+
+/* Returns the number of faults timed in STATS. */
+static unsigned long long
+timed_cnt (const struct vmstat *stats)
+{
+  unsigned long long cnt = 0;
+  int i;
+
+  for (i = 0; i < VMSTAT_LAT_BUCKETS; i++)
+    cnt += stats->fault_lat[i];
+  return cnt;
+}
+
+/* Writes to a stack frame large enough to need new stack pages. */
+static int
+grow_stack (void)
+{
+  volatile char big[4 * PAGE];
+  big[0] = 1;
+  return big[0];
+}
+
+void
+test_main (void)
+{
+  struct vmstat before, after, all;
+  size_t i;
+
+  CHECK (vmstat (VMSTAT_SELF, &before) == 0, "vmstat VMSTAT_SELF");
+  for (i = 0; i < PAGES; i++)
+    zeros[i * PAGE] = 1;
+  CHECK (grow_stack () == 1, "grow stack");
+  CHECK (vmstat (VMSTAT_SELF, &after) == 0, "vmstat VMSTAT_SELF");
+
+  if (after.events[VM_FAULT_ZERO] + after.events[VM_FAULT_PROT]
+      < before.events[VM_FAULT_ZERO] + before.events[VM_FAULT_PROT] + 1)
+    fail ("writes to zero pages were not counted");
+  if (after.events[VM_FAULT_STACK] <= before.events[VM_FAULT_STACK])
+    fail ("stack growth was not counted");
+  if (timed_cnt (&after) != fault_cnt (&after))
+    fail ("%llu faults timed, %llu counted",
+          timed_cnt (&after), fault_cnt (&after));
+
+  CHECK (vmstat (VMSTAT_ALL, &all) == 0, "vmstat VMSTAT_ALL");
+  if (fault_cnt (&all) < fault_cnt (&after))
+    fail ("system counted fewer faults than this process");
+
+  CHECK (vmstat (2, &all) == -1, "vmstat bad selector");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(vmstat) begin
+(vmstat) vmstat VMSTAT_SELF
+(vmstat) grow stack
+(vmstat) vmstat VMSTAT_SELF
+(vmstat) vmstat VMSTAT_ALL
+(vmstat) vmstat bad selector
+(vmstat) end
+EOF
+pass;
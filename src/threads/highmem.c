@@ -0,0 +1,211 @@
+#include "threads/highmem.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/loader.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* High memory.  The kernel maps physical memory at PHYS_BASE only
+   up to init_ram_pages, the 64 MB that start.S builds page tables
+   for; palloc's pools live in that range.  RAM above it is "high
+   memory", which is handed out a page at a time and only for user
+   frames.
+
+   A high page is named by the kernel address it would have if the
+   direct mapping went on, ptov() of its physical address.  That
+   keeps pagedir_set_page(), pagedir_get_page() and the frame table
+   working unchanged, but nothing is mapped at that address: the
+   kernel reaches the contents of a high page only through a
+   temporary mapping made with kmap() and undone with kunmap().
+   Both accept ordinary pages too, which need no mapping, so code
+   that handles user frames can call them on every page.
+
+   Temporary mappings go in the last 4 MB of virtual memory, whose
+   page table is shared by every page directory, so a mapping made
+   while one process runs is valid in all of them.  High pages are
+   named below that window and the vmalloc() window under it, which
+   limits high memory to just under 1 GB of physical memory in all. */
+
+/* The kmap window: one page table's worth of slots. */
+#define KMAP_SLOTS (PTSPAN / PGSIZE)
+
+/* High pages. */
+static struct lock high_lock;
+static struct bitmap *high_map;         /* Used high pages, or NULL if none. */
+static uint8_t *high_base;              /* Name of the first high page. */
+
+/* Temporary mappings. */
+static struct lock kmap_lock;
+static struct condition kmap_freed;     /* Signalled when a slot frees up. */
+static struct bitmap *kmap_slots;       /* Slots in use. */
+static uint32_t *kmap_pt;               /* Page table of the window. */
+
+static unsigned long long kmap_cnt;      /* Temporary mappings made. */
+static unsigned long long kmap_wait_cnt; /* Waits for a free slot. */
+
+/* Sets up the kmap window and the high page allocator, taking at
+   most USER_PAGE_LIMIT user pages in all, counting those of the
+   user pool.  Must be called after paging_init() and before any
+   page directory is created. */
+void
+highmem_init (size_t user_page_limit)
+{
+  size_t user_cnt, page_cnt;
+
+  lock_init (&high_lock);
+  lock_init (&kmap_lock);
+  cond_init (&kmap_freed);
+
+  kmap_pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  init_page_dir[pd_no (KMAP_BASE)] = pde_create (kmap_pt);
+  kmap_slots = bitmap_create (KMAP_SLOTS);
+  if (kmap_slots == NULL)
+    PANIC ("Not enough memory for kmap slots.");
+
+  high_base = ptov (init_ram_pages * PGSIZE);
+  page_cnt = init_high_pages;
+  if (page_cnt > (size_t) ((uint8_t *) VMALLOC_BASE - high_base) / PGSIZE)
+    page_cnt = ((uint8_t *) VMALLOC_BASE - high_base) / PGSIZE;
+  palloc_pool_base (PAL_USER, &user_cnt);
+  if (page_cnt > user_page_limit - user_cnt)
+    page_cnt = user_page_limit - user_cnt;
+  if (page_cnt == 0)
+    return;
+
+  high_map = bitmap_create (page_cnt);
+  if (high_map == NULL)
+    PANIC ("Not enough memory for high memory bitmap.");
+  printf ("%zu pages available in high memory.\n", page_cnt);
+}
+
+/* Obtains a free high page and returns its name, or a null
+   pointer if high memory is exhausted.  Only user pages come from
+   high memory, so FLAGS must include PAL_USER.  If PAL_ZERO is
+   set, the page is filled with zeros. */
+void *
+highmem_get_page (enum palloc_flags flags)
+{
+  size_t page_idx;
+  void *page;
+
+  ASSERT (flags & PAL_USER);
+  if (high_map == NULL)
+    return NULL;
+
+  lock_acquire (&high_lock);
+  page_idx = bitmap_scan_and_flip (high_map, 0, 1, false);
+  lock_release (&high_lock);
+  if (page_idx == BITMAP_ERROR)
+    return NULL;
+
+  page = high_base + page_idx * PGSIZE;
+  if (flags & PAL_ZERO)
+    {
+      void *kaddr = kmap (page);
+      memset (kaddr, 0, PGSIZE);
+      kunmap (kaddr);
+    }
+  return page;
+}
+
+/* Frees the high page named PAGE. */
+void
+highmem_free_page (void *page)
+{
+  size_t page_idx;
+
+  ASSERT (highmem_contains (page));
+  ASSERT (pg_ofs (page) == 0);
+
+  page_idx = pg_no (page) - pg_no (high_base);
+  lock_acquire (&high_lock);
+  ASSERT (bitmap_test (high_map, page_idx));
+  bitmap_reset (high_map, page_idx);
+  lock_release (&high_lock);
+}
+
+/* Returns the number of free high pages. */
+size_t
+highmem_free_cnt (void)
+{
+  size_t cnt;
+
+  if (high_map == NULL)
+    return 0;
+  lock_acquire (&high_lock);
+  cnt = bitmap_count (high_map, 0, bitmap_size (high_map), false);
+  lock_release (&high_lock);
+  return cnt;
+}
+
+/* Returns true if PAGE names a high page. */
+bool
+highmem_contains (const void *page)
+{
+  return (high_map != NULL
+          && (const uint8_t *) page >= high_base
+          && (const uint8_t *) page < high_base + bitmap_size (high_map) * PGSIZE);
+}
+
+/* Returns a kernel address at which the contents of PAGE can be
+   accessed until the matching kunmap().  An ordinary page is
+   returned as is; a high page is mapped into a free slot of the
+   kmap window, waiting for one if all are taken. */
+void *
+kmap (const void *page)
+{
+  size_t slot;
+
+  ASSERT (pg_ofs (page) == 0);
+  if (!highmem_contains (page))
+    return (void *) page;
+
+  lock_acquire (&kmap_lock);
+  while ((slot = bitmap_scan_and_flip (kmap_slots, 0, 1, false)) == BITMAP_ERROR)
+    {
+      kmap_wait_cnt++;
+      cond_wait (&kmap_freed, &kmap_lock);
+    }
+  kmap_cnt++;
+  lock_release (&kmap_lock);
+
+  /* A slot that is not present cannot be cached in the TLB, so
+     there is nothing to invalidate before using it. */
+  kmap_pt[slot] = pte_create_kernel ((void *) page, true);
+  return (uint8_t *) KMAP_BASE + slot * PGSIZE;
+}
+
+/* Undoes the kmap() that returned KADDR. */
+void
+kunmap (void *kaddr)
+{
+  size_t slot;
+
+  if (kaddr < KMAP_BASE)
+    return;
+
+  slot = pg_no (kaddr) - pg_no (KMAP_BASE);
+  kmap_pt[slot] = 0;
+  asm volatile ("invlpg (%0)" : : "r" (kaddr) : "memory");
+
+  lock_acquire (&kmap_lock);
+  bitmap_reset (kmap_slots, slot);
+  cond_signal (&kmap_freed, &kmap_lock);
+  lock_release (&kmap_lock);
+}
+
+/* Prints high memory statistics. */
+void
+highmem_print_stats (void)
+{
+  if (high_map == NULL)
+    return;
+  printf ("High memory: %zu pages, %zu free, %llu kmaps, %llu waits\n",
+          bitmap_size (high_map), highmem_free_cnt (), kmap_cnt,
+          kmap_wait_cnt);
+}
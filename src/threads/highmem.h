@@ -0,0 +1,19 @@
+#ifndef THREADS_HIGHMEM_H
+#define THREADS_HIGHMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/palloc.h"
+
+void highmem_init (size_t user_page_limit);
+void *highmem_get_page (enum palloc_flags);
+void highmem_free_page (void *);
+size_t highmem_free_cnt (void);
+bool highmem_contains (const void *);
+
+void *kmap (const void *page);
+void kunmap (void *kaddr);
+
+void highmem_print_stats (void);
+
+#endif /* threads/highmem.h */
@@ -15,13 +15,16 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/highmem.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/shrinker.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -34,6 +37,11 @@
 #ifdef VM
 #include "devices/swap.h"
 #include "vm/frame.h"
+#include "vm/compact.h"
+#include "vm/ksm.h"
+#include "vm/largepage.h"
+#include "vm/rss.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
@@ -99,9 +107,12 @@ main (void)
           init_ram_pages * PGSIZE / 1024);
 
   /* Initialize memory system. */
+  shrinker_init ();
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  highmem_init (user_page_limit);
+  vmalloc_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -260,7 +271,31 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-swapdev"))
+        {
+          if (value == NULL || !swap_add_device (value))
+            PANIC ("bad or too many -swapdev options");
+        }
 #endif
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-vmpolicy"))
+        {
+          if (value == NULL || !vm_policy_select (value))
+            PANIC ("unknown page replacement policy `%s'", value);
+        }
+      else if (!strcmp (name, "-zswap"))
+        zswap_pages = atoi (value);
+      else if (!strcmp (name, "-rss-soft"))
+        rss_soft_limit = atoi (value);
+      else if (!strcmp (name, "-rss-hard"))
+        rss_hard_limit = atoi (value);
+      else if (!strcmp (name, "-ksm"))
+        ksm_pages = atoi (value);
+      else if (!strcmp (name, "-no-largepages"))
+        largepage_enabled = false;
+      else if (!strcmp (name, "-kcompactd"))
+        compact_daemon = true;
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -385,12 +420,27 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -swapdev=BDEV[:PRIO] Also swap to BDEV, used before devices of\n"
+          "                     lower PRIO (default 0); repeatable.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -vmpolicy=POLICY   Replace pages with POLICY: clock (default),\n"
+          "                     wsclock, clockpro or 2q.\n"
+          "  -zswap=PAGES       Compress swapped pages into PAGES kernel pages\n"
+          "                     before using the swap device (0 to disable).\n"
+          "  -rss-soft=PAGES    Reclaim first from processes over PAGES resident.\n"
+          "  -rss-hard=PAGES    Keep each process to at most PAGES resident.\n"
+          "  -ksm=PAGES         Merge identical anonymous pages, scanning PAGES\n"
+          "                     frames every 100 ms (default 0, disabled).\n"
+          "  -no-largepages     Never map anonymous memory with 4 MB pages.\n"
+          "  -kcompactd         Compact user memory in the background to keep\n"
+          "                     a 4 MB aligned run free for large pages.\n"
 #endif
           );
   shutdown_power_off ();
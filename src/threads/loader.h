@@ -35,6 +35,10 @@
 
 /* Amount of physical memory, in 4 kB pages. */
 extern uint32_t init_ram_pages;
+
+/* Amount of physical memory above what the kernel maps, in 4 kB
+   pages.  See threads/highmem.c. */
+extern uint32_t init_high_pages;
 #endif
 
 #endif /* threads/loader.h */
@@ -6,8 +6,10 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/palloc.h"
+#include "threads/shrinker.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -26,13 +28,18 @@
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
    blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
+   and give the arena back to the page allocator, unless the
+   descriptor keeps fewer than SPARE_ARENAS empty arenas, in which
+   case the arena stays for the next requests.  A shrinker gives
+   spare arenas back when the kernel pool runs short.
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If no
+   run of contiguous pages is free, the pages come from vmalloc()
+   instead, which only makes them contiguous in virtual memory. */
 
 /* Descriptor. */
 struct desc
@@ -40,9 +47,13 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t empty_cnt;           /* Arenas with no block in use. */
     struct lock lock;           /* Lock. */
   };
 
+/* Empty arenas a descriptor keeps instead of freeing them. */
+#define SPARE_ARENAS 4
+
 /* Magic number for detecting arena corruption. */
 #define ARENA_MAGIC 0x9a548eed
 
@@ -66,6 +77,17 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void release_arena (struct desc *, struct arena *);
+static size_t malloc_shrink_count (void);
+static size_t malloc_shrink_scan (size_t page_cnt);
+
+static struct shrinker malloc_shrinker =
+  {
+    .name = "malloc",
+    .pool = 0,
+    .count = malloc_shrink_count,
+    .scan = malloc_shrink_scan,
+  };
 
 /* Initializes the malloc() descriptors. */
 void
@@ -80,8 +102,10 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
+      d->empty_cnt = 0;
       lock_init (&d->lock);
     }
+  shrinker_register (&malloc_shrinker);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -108,6 +132,8 @@ malloc (size_t size)
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL)
+        a = vmalloc (page_cnt * PGSIZE);
       if (a == NULL)
         return NULL;
 
@@ -126,29 +152,44 @@ malloc (size_t size)
     {
       size_t i;
 
-      /* Allocate a page. */
+      /* Allocate a page.  D's lock is dropped meanwhile: palloc
+         may run the shrinkers, and those free memory, which takes
+         D's lock. */
+      lock_release (&d->lock);
       a = palloc_get_page (0);
-      if (a == NULL) 
+      lock_acquire (&d->lock);
+
+      if (a == NULL || !list_empty (&d->free_list))
         {
-          lock_release (&d->lock);
-          return NULL; 
+          /* Another thread may have refilled the free list. */
+          if (a != NULL)
+            palloc_free_page (a);
+          if (list_empty (&d->free_list))
+            {
+              lock_release (&d->lock);
+              return NULL;
+            }
         }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
+      else
         {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
+          /* Initialize arena and add its blocks to the free list. */
+          a->magic = ARENA_MAGIC;
+          a->desc = d;
+          a->free_cnt = d->blocks_per_arena;
+          d->empty_cnt++;
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct block *b = arena_to_block (a, i);
+              list_push_back (&d->free_list, &b->free_elem);
+            }
         }
     }
 
   /* Get a block from free list and return it. */
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
-  a->free_cnt--;
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_cnt--;
   lock_release (&d->lock);
   return b;
 }
@@ -238,18 +279,15 @@ free (void *p)
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
 
-          /* If the arena is now entirely unused, free it. */
+          /* If the arena is now entirely unused, keep it as a
+             spare or free it. */
           if (++a->free_cnt >= d->blocks_per_arena) 
             {
-              size_t i;
-
               ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              if (d->empty_cnt < SPARE_ARENAS)
+                d->empty_cnt++;
+              else
+                release_arena (d, a);
             }
 
           lock_release (&d->lock);
@@ -257,12 +295,78 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          if (is_vmalloc_addr (a))
+            vfree (a);
+          else
+            palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Removes the blocks of A, an arena of D with no block in use,
+   from D's free list and frees A.  Must be called with D's lock
+   held. */
+static void
+release_arena (struct desc *d, struct arena *a)
+{
+  size_t i;
+
+  for (i = 0; i < d->blocks_per_arena; i++) 
+    {
+      struct block *b = arena_to_block (a, i);
+      list_remove (&b->free_elem);
+    }
+  palloc_free_page (a);
+}
+
+/* Returns the number of spare arenas, for the shrinker. */
+static size_t
+malloc_shrink_count (void)
+{
+  size_t cnt = 0;
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    cnt += descs[i].empty_cnt;
+  return cnt;
+}
+
+/* Frees up to PAGE_CNT spare arenas, skipping descriptors that are
+   busy.  Returns the number freed. */
+static size_t
+malloc_shrink_scan (size_t page_cnt)
+{
+  size_t freed = 0;
+  size_t i;
+
+  for (i = 0; i < desc_cnt && freed < page_cnt; i++)
+    {
+      struct desc *d = &descs[i];
+      struct list_elem *e;
+
+      if (d->empty_cnt == 0 || !shrinker_try_lock (&d->lock))
+        continue;
+      for (e = list_begin (&d->free_list);
+           e != list_end (&d->free_list) && d->empty_cnt > 0 && freed < page_cnt; )
+        {
+          struct arena *a = block_to_arena (list_entry (e, struct block,
+                                                        free_elem));
+          if (a->free_cnt == d->blocks_per_arena)
+            {
+              release_arena (d, a);
+              d->empty_cnt--;
+              freed++;
+              e = list_begin (&d->free_list);
+            }
+          else
+            e = list_next (e);
+        }
+      lock_release (&d->lock);
+    }
+  return freed;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
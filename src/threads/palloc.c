@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
+#include "threads/shrinker.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -39,6 +40,7 @@ static struct pool kernel_pool, user_pool;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *pool_of_page (void *page);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -65,8 +67,9 @@ palloc_init (size_t user_page_limit)
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
    then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   available, the pool's caches are shrunk once and the request
+   retried; if that fails too, returns a null pointer, unless
+   PAL_ASSERT is set in FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
@@ -81,6 +84,13 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
   lock_release (&pool->lock);
 
+  if (page_idx == BITMAP_ERROR && shrink_caches (flags, page_cnt) > 0)
+    {
+      lock_acquire (&pool->lock);
+      page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+      lock_release (&pool->lock);
+    }
+
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
   else
@@ -100,6 +110,45 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
+/* Obtains PAGE_CNT contiguous free pages like palloc_get_multiple(),
+   except that the first page's address is a multiple of ALIGN pages,
+   so that the pages can be mapped with one large page.  Returns a null
+   pointer if no suitably aligned run is free. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt, size_t align)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t pool_cnt = bitmap_size (pool->used_map);
+  size_t page_idx;
+  void *pages = NULL;
+
+  ASSERT (align > 0);
+  if (page_cnt == 0)
+    return NULL;
+
+  /* First index whose page is ALIGN aligned. */
+  page_idx = (align - pg_no (pool->base) % align) % align;
+
+  lock_acquire (&pool->lock);
+  for (; page_idx + page_cnt <= pool_cnt; page_idx += align)
+    if (bitmap_none (pool->used_map, page_idx, page_cnt))
+      {
+        bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+        pages = pool->base + PGSIZE * page_idx;
+        break;
+      }
+  lock_release (&pool->lock);
+
+  if (pages != NULL)
+    {
+      if (flags & PAL_ZERO)
+        memset (pages, 0, PGSIZE * page_cnt);
+    }
+  else if (flags & PAL_ASSERT)
+    PANIC ("palloc_get: out of pages");
+  return pages;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -148,6 +197,67 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the number of free pages in the user pool if PAL_USER is
+   set in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_free_cnt (enum palloc_flags flags)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  size_t cnt;
+
+  lock_acquire (&pool->lock);
+  cnt = bitmap_count (pool->used_map, 0, bitmap_size (pool->used_map), false);
+  lock_release (&pool->lock);
+  return cnt;
+}
+
+/* Returns the first page of the user pool if PAL_USER is set in
+   FLAGS, otherwise of the kernel pool, and stores the number of
+   pages in the pool in *PAGE_CNT. */
+void *
+palloc_pool_base (enum palloc_flags flags, size_t *page_cnt)
+{
+  struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+
+  *page_cnt = bitmap_size (pool->used_map);
+  return pool->base;
+}
+
+/* Returns the number of free pages among the PAGE_CNT pages
+   starting at PAGES, which must all lie in one pool. */
+size_t
+palloc_free_in (void *pages, size_t page_cnt)
+{
+  struct pool *pool = pool_of_page (pages);
+  size_t page_idx, cnt;
+
+  page_idx = pg_no (pages) - pg_no (pool->base);
+  lock_acquire (&pool->lock);
+  cnt = bitmap_count (pool->used_map, page_idx, page_cnt, false);
+  lock_release (&pool->lock);
+  return cnt;
+}
+
+/* Allocates the particular page PAGE, returning true if it was
+   free.  The page is freed with palloc_free_page() as usual. */
+bool
+palloc_claim (void *page)
+{
+  struct pool *pool = pool_of_page (page);
+  size_t page_idx;
+  bool claimed;
+
+  ASSERT (pg_ofs (page) == 0);
+
+  page_idx = pg_no (page) - pg_no (pool->base);
+  lock_acquire (&pool->lock);
+  claimed = !bitmap_test (pool->used_map, page_idx);
+  if (claimed)
+    bitmap_mark (pool->used_map, page_idx);
+  lock_release (&pool->lock);
+  return claimed;
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -180,3 +290,14 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the pool PAGE was allocated from. */
+static struct pool *
+pool_of_page (void *page)
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  NOT_REACHED ();
+}
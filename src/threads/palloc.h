@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* How to allocate pages. */
@@ -14,7 +15,12 @@ enum palloc_flags
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_aligned (enum palloc_flags, size_t page_cnt, size_t align);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+size_t palloc_free_cnt (enum palloc_flags);
+void *palloc_pool_base (enum palloc_flags, size_t *page_cnt);
+size_t palloc_free_in (void *pages, size_t page_cnt);
+bool palloc_claim (void *page);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,125 @@
+#include "threads/shrinker.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* Shrinker registry.  Caches that keep pages they could do
+   without register a shrinker.  Before the page allocator gives up
+   on a request, and when the reclaim thread finds user memory
+   short, shrink_caches() asks the shrinkers of the pool concerned
+   to free pages, each in proportion to what it holds, so that a
+   cache can be sized generously without causing allocations to
+   fail.
+
+   Shrinking happens with whatever locks the allocating thread
+   holds, so shrinkers only try their locks (see
+   shrinker_try_lock()).  A shrinker that allocates memory would
+   recurse; shrink_caches() ignores such nested calls. */
+
+static struct list shrinkers;   /* All registered shrinkers. */
+static struct lock shrinker_lock;
+
+static unsigned long long run_cnt;      /* Calls that found shrinkers. */
+static unsigned long long freed_cnt;    /* Pages freed by them. */
+
+/* Initializes the registry.  Must be called before malloc_init(),
+   which registers a shrinker. */
+void
+shrinker_init (void)
+{
+  list_init (&shrinkers);
+  lock_init (&shrinker_lock);
+}
+
+/* Adds S to the registry. */
+void
+shrinker_register (struct shrinker *s)
+{
+  ASSERT (s->count != NULL && s->scan != NULL);
+
+  s->freed_cnt = 0;
+  lock_acquire (&shrinker_lock);
+  list_push_back (&shrinkers, &s->elem);
+  lock_release (&shrinker_lock);
+}
+
+/* Removes S from the registry. */
+void
+shrinker_unregister (struct shrinker *s)
+{
+  lock_acquire (&shrinker_lock);
+  list_remove (&s->elem);
+  lock_release (&shrinker_lock);
+}
+
+/* Asks the shrinkers of the user pool, if PAL_USER is set in
+   FLAGS, or else of the kernel pool, to free PAGE_CNT pages
+   between them, each a share proportional to the pages it could
+   free.  Returns the number of pages freed. */
+size_t
+shrink_caches (enum palloc_flags flags, size_t page_cnt)
+{
+  enum palloc_flags pool = flags & PAL_USER;
+  struct list_elem *e;
+  size_t total = 0, freed = 0;
+
+  if (intr_context () || page_cnt == 0
+      || lock_held_by_current_thread (&shrinker_lock))
+    return 0;
+
+  lock_acquire (&shrinker_lock);
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      if (s->pool == pool)
+        total += s->count ();
+    }
+
+  if (total > 0)
+    {
+      run_cnt++;
+      for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+           e = list_next (e))
+        {
+          struct shrinker *s = list_entry (e, struct shrinker, elem);
+          size_t cnt = s->pool == pool ? s->count () : 0;
+          size_t done;
+
+          if (cnt == 0)
+            continue;
+          done = s->scan (DIV_ROUND_UP (page_cnt * cnt, total));
+          s->freed_cnt += done;
+          freed += done;
+        }
+      freed_cnt += freed;
+    }
+  lock_release (&shrinker_lock);
+  return freed;
+}
+
+/* Acquires LOCK for a shrinker if that can be done without
+   waiting, returning true if successful. */
+bool
+shrinker_try_lock (struct lock *lock)
+{
+  return !lock_held_by_current_thread (lock) && lock_try_acquire (lock);
+}
+
+/* Prints shrinker statistics. */
+void
+shrinker_print_stats (void)
+{
+  struct list_elem *e;
+
+  printf ("Shrinkers: %llu runs, %llu pages freed", run_cnt, freed_cnt);
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      printf (", %llu by %s", s->freed_cnt, s->name);
+    }
+  printf ("\n");
+}
@@ -0,0 +1,37 @@
+#ifndef THREADS_SHRINKER_H
+#define THREADS_SHRINKER_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/palloc.h"
+
+struct lock;
+
+/* A cache that can give pages back to the page allocator. */
+struct shrinker
+  {
+    const char *name;           /* For statistics. */
+    enum palloc_flags pool;     /* PAL_USER if its pages come from the
+                                   user pool, 0 for the kernel pool. */
+
+    /* Returns the number of pages the cache could free now. */
+    size_t (*count) (void);
+
+    /* Frees up to PAGE_CNT pages and returns how many it freed.
+       The allocating thread may hold any lock, so this must only
+       try to acquire locks, and give up on ones it cannot get. */
+    size_t (*scan) (size_t page_cnt);
+
+    unsigned long long freed_cnt;   /* Pages freed so far. */
+    struct list_elem elem;          /* Registry element. */
+  };
+
+void shrinker_init (void);
+void shrinker_register (struct shrinker *);
+void shrinker_unregister (struct shrinker *);
+size_t shrink_caches (enum palloc_flags, size_t page_cnt);
+bool shrinker_try_lock (struct lock *);
+void shrinker_print_stats (void);
+
+#endif /* threads/shrinker.h */
@@ -288,10 +288,14 @@ thread_create(const char *name, int priority,
   tid = t->tid = allocate_tid();
 
   /* Setup the parent_relation for the child thread 
-     child_tid should be assigned after allocate_tid */
-  struct relation *parent_rel = list_entry(list_begin(&running_thread()->children_relation_list), struct relation, elem);
-  parent_rel->child_tid = t->tid;
-  t->parent_relation = parent_rel;
+     child_tid should be assigned after allocate_tid.
+     Kernel threads such as idle are created without one. */
+  if (!list_empty(&running_thread()->children_relation_list))
+    {
+      struct relation *parent_rel = list_entry(list_begin(&running_thread()->children_relation_list), struct relation, elem);
+      parent_rel->child_tid = t->tid;
+      t->parent_relation = parent_rel;
+    }
 
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack'
@@ -726,6 +730,10 @@ init_thread(struct thread *t, const char *name, int priority, int nice, real rec
   /* Initialize mmap_list and next_mapid. */
   list_init(&(t->mmap_list));
   t->next_mapid=1;
+
+  /* The table is only set up for user processes, but every thread
+     tears it down on exit. */
+  lock_init(&t->spt.lock);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -7,6 +7,8 @@
 #include "fixed-point.h"
 #include "synch.h"
 #include "hash.h"
+#include "avl.h"
+#include <vmstat.h>
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -86,6 +88,24 @@ typedef int tid_t;
    only because they are mutually exclusive: only a thread in the
    ready state is on the run queue, whereas only a thread in the
    blocked state is on a semaphore wait list. */
+#ifdef VM
+/* Sequential access state of a file mapping, driving readahead. */
+struct readahead
+  {
+    void *next;                         /* Page a sequential reader faults on next. */
+    size_t window;                      /* Pages read ahead last time, 0 if random. */
+  };
+
+/* Supplemental page table of a process.  Other threads look pages up
+   in it while the owner adds and removes them, so the lock guards the
+   table itself; it is always taken last and held only briefly. */
+struct spt
+  {
+    struct hash table;                  /* Maps page addresses to spt_entries. */
+    struct lock lock;                   /* Guards table. */
+  };
+#endif
+
 struct thread
   {
     /* Owned by thread.c. */
@@ -113,9 +133,17 @@ struct thread
 #endif
 
 #ifdef VM
-  struct hash spt;
+  struct spt spt;                       /* Supplemental page table. */
+  struct avl vmas;                      /* Regions of the address space. */
   struct list mmap_list; 
   int next_mapid;
+  struct readahead exec_ra;             /* Readahead of the executable. */
+  uint8_t *heap_start;                  /* First page of the heap. */
+  uint8_t *brk;                         /* Program break, the end of the heap. */
+  size_t rss;                           /* Resident pages mapped. */
+  size_t wss;                           /* Working set size estimate. */
+  size_t ws_sample;                     /* Pages seen accessed this period. */
+  struct vmstat vmstat;                 /* Faults and evictions of this process. */
 #endif
 
     /* Owned by thread.c. */
@@ -52,6 +52,12 @@ static inline void *pg_round_down (const void *va) {
    virtual address space belongs to the kernel. */
 #define	PHYS_BASE ((void *) LOADER_PHYS_BASE)
 
+/* Kernel virtual memory past the mapping of RAM.  The last 4 MB
+   hold temporary mappings of high memory (see threads/highmem.c),
+   the 16 MB below them vmalloc() ranges (see threads/vmalloc.c). */
+#define KMAP_BASE ((void *) 0xffc00000)
+#define VMALLOC_BASE ((void *) 0xfec00000)
+
 /* Returns true if VADDR is a user virtual address. */
 static inline bool
 is_user_vaddr (const void *vaddr) 
@@ -0,0 +1,164 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Virtually contiguous kernel allocations.
+
+   vmalloc() returns a range of kernel virtual memory backed by
+   single pages from the kernel pool, so a large allocation does
+   not fail just because no run of physically contiguous pages is
+   free.  malloc() falls back to it for big blocks.
+
+   Ranges come from the window between VMALLOC_BASE and KMAP_BASE.
+   Its page tables are made at boot, before any page directory
+   copies the kernel's entries, so every page directory shares them
+   and a range is usable in every process as soon as it is mapped.
+   Each range is followed by an unmapped guard page, which catches
+   overruns and tells vfree() where the range ends. */
+
+#define VMALLOC_PTS 4                   /* Page tables of the window. */
+#define VMALLOC_PAGES (VMALLOC_PTS * (PTSPAN / PGSIZE))
+
+static struct lock vmalloc_lock;
+static struct bitmap *vmalloc_map;      /* Pages of the window in use,
+                                           guard pages included. */
+static uint32_t *vmalloc_pt[VMALLOC_PTS]; /* Page tables of the window. */
+
+static size_t range_cnt;                /* Ranges allocated now. */
+static size_t mapped_cnt;               /* Pages mapped now. */
+
+/* Returns the page table entry of page IDX of the window. */
+static uint32_t *
+window_pte (size_t idx)
+{
+  return &vmalloc_pt[idx / (PTSPAN / PGSIZE)][idx % (PTSPAN / PGSIZE)];
+}
+
+/* Sets up the vmalloc() window.  Must be called after
+   paging_init() and before any page directory is created. */
+void
+vmalloc_init (void)
+{
+  size_t i;
+
+  ASSERT ((uint8_t *) VMALLOC_BASE + VMALLOC_PTS * PTSPAN
+          == (uint8_t *) KMAP_BASE);
+
+  lock_init (&vmalloc_lock);
+  for (i = 0; i < VMALLOC_PTS; i++)
+    {
+      vmalloc_pt[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      init_page_dir[pd_no (VMALLOC_BASE) + i] = pde_create (vmalloc_pt[i]);
+    }
+  vmalloc_map = bitmap_create (VMALLOC_PAGES);
+  if (vmalloc_map == NULL)
+    PANIC ("Not enough memory for vmalloc bitmap.");
+}
+
+/* Unmaps and frees the pages of the range starting at page START
+   of the window, up to its guard page.  Returns the number of
+   pages freed. */
+static size_t
+unmap_range (size_t start)
+{
+  size_t idx;
+
+  for (idx = start; *window_pte (idx) & PTE_P; idx++)
+    {
+      uint32_t *pte = window_pte (idx);
+      void *page = pte_get_page (*pte);
+
+      *pte = 0;
+      asm volatile ("invlpg (%0)"
+                    : : "r" ((uint8_t *) VMALLOC_BASE + idx * PGSIZE)
+                    : "memory");
+      palloc_free_page (page);
+    }
+  return idx - start;
+}
+
+/* Obtains and returns a virtually contiguous range of at least
+   SIZE bytes of kernel memory, or a null pointer if the window or
+   the kernel pool is exhausted.  The memory is not zeroed and is
+   page aligned. */
+void *
+vmalloc (size_t size)
+{
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  size_t start, i;
+
+  if (vmalloc_map == NULL || page_cnt == 0)
+    return NULL;
+
+  lock_acquire (&vmalloc_lock);
+  start = bitmap_scan_and_flip (vmalloc_map, 0, page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+  if (start == BITMAP_ERROR)
+    return NULL;
+
+  /* The pages are unmapped, so none of them is in the TLB. */
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *page = palloc_get_page (0);
+      if (page == NULL)
+        {
+          unmap_range (start);
+          lock_acquire (&vmalloc_lock);
+          bitmap_set_multiple (vmalloc_map, start, page_cnt + 1, false);
+          lock_release (&vmalloc_lock);
+          return NULL;
+        }
+      *window_pte (start + i) = pte_create_kernel (page, true);
+    }
+
+  lock_acquire (&vmalloc_lock);
+  range_cnt++;
+  mapped_cnt += page_cnt;
+  lock_release (&vmalloc_lock);
+  return (uint8_t *) VMALLOC_BASE + start * PGSIZE;
+}
+
+/* Frees the range at P, which must have been returned by
+   vmalloc().  If P is a null pointer, does nothing. */
+void
+vfree (void *p)
+{
+  size_t start, page_cnt;
+
+  if (p == NULL)
+    return;
+  ASSERT (is_vmalloc_addr (p));
+  ASSERT (pg_ofs (p) == 0);
+
+  start = pg_no (p) - pg_no (VMALLOC_BASE);
+  page_cnt = unmap_range (start);
+  ASSERT (page_cnt > 0);
+
+  lock_acquire (&vmalloc_lock);
+  bitmap_set_multiple (vmalloc_map, start, page_cnt + 1, false);
+  range_cnt--;
+  mapped_cnt -= page_cnt;
+  lock_release (&vmalloc_lock);
+}
+
+/* Returns true if P lies in the vmalloc() window. */
+bool
+is_vmalloc_addr (const void *p)
+{
+  return p >= VMALLOC_BASE && p < KMAP_BASE;
+}
+
+/* Prints vmalloc() statistics. */
+void
+vmalloc_print_stats (void)
+{
+  printf ("vmalloc: %zu ranges, %zu pages\n", range_cnt, mapped_cnt);
+}
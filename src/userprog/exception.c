@@ -10,6 +10,7 @@
 #include "devices/swap.h"
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/vmstat.h"
 #include "process.h"
 
 /* Number of page faults processed. */
@@ -132,9 +133,10 @@ static void
 page_fault (struct intr_frame *f) 
 {
   bool not_present;  /* True: not-present page, false: writing r/o page. */
-//   bool write;        /* True: access was write, false: access was read. */
+  bool write;        /* True: access was write, false: access was read. */
 //   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
+  uint64_t start = vmstat_now ();  /* Time the fault arrived. */
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It say point to code or to
@@ -154,7 +156,7 @@ page_fault (struct intr_frame *f)
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
-//   write = (f->error_code & PF_W) != 0;
+  write = (f->error_code & PF_W) != 0;
 //   user = (f->error_code & PF_U) != 0;
 
    /* Causes of page_fault not_present
@@ -176,20 +178,28 @@ page_fault (struct intr_frame *f)
          else {
             expand_stack(fault_addr);
          }
+         vmstat_fault(VM_FAULT_STACK, start);
          return;
       }
 
       /* If in the supplemental page table, try to load it or share from existing page */
-      bool page_success = page_fault_helper(spte);
+      enum vm_event event = page_fault_event(spte, write);
+      bool page_success = page_fault_helper(spte, write);
 
       if (!page_success)
       {
          exit(EXIT_ERROR);
       }
+      vmstat_fault(event, start);
    }
    else
    {
-      exit(EXIT_ERROR);
+      /* Writing a read-only page is only allowed if the page is
+         writable but shared copy-on-write with a forked process */
+      struct spt_entry *spte = find_spte(fault_addr);
+      if (!write || spte == NULL || !spte->writable || !page_cow_helper(spte))
+         exit(EXIT_ERROR);
+      vmstat_fault(VM_FAULT_PROT, start);
    }
 }
 
@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include "threads/highmem.h"
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
@@ -34,25 +35,51 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if ((*pde & PTE_P) && !(*pde & PTE_PS))
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
         
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
           if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
+            {
+              void *page = pte_get_page (*pte);
+              if (highmem_contains (page))
+                highmem_free_page (page);
+              else
+                palloc_free_page (page);
+            }
         palloc_free_page (pt);
       }
   palloc_free_page (pd);
 }
 
+/* Destroys page directory PD and its page tables, but not the pages
+   they map, which the frame table has already taken back. */
+void
+pagedir_destroy_tables (uint32_t *pd)
+{
+  uint32_t *pde;
+
+  if (pd == NULL)
+    return;
+
+  ASSERT (pd != init_page_dir);
+  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
+    if ((*pde & PTE_P) && !(*pde & PTE_PS))
+      palloc_free_page (pde_get_pt (*pde));
+  palloc_free_page (pd);
+}
+
 /* Returns the address of the page table entry for virtual
    address VADDR in page directory PD.
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.
+   If VADDR is in a large page, the page directory entry is
+   returned instead; its flag bits have the same meaning but
+   cover the whole large page. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -80,6 +107,9 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
         return NULL;
     }
 
+  if (*pde & PTE_PS)
+    return pde;
+
   /* Return the page table entry. */
   pt = pde_get_pt (*pde);
   return &pt[pt_no (vaddr)];
@@ -103,9 +133,10 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (pg_ofs (kpage) == 0);
   ASSERT (is_user_vaddr (upage));
-  ASSERT (vtop (kpage) >> PTSHIFT < init_ram_pages);
+  ASSERT (vtop (kpage) >> PTSHIFT < init_ram_pages || highmem_contains (kpage));
   ASSERT (pd != init_page_dir);
 
+  ASSERT (!pagedir_is_large (pd, upage));
   pte = lookup_page (pd, upage, true);
 
   if (pte != NULL) 
@@ -130,6 +161,8 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
   ASSERT (is_user_vaddr (uaddr));
   
   pte = lookup_page (pd, uaddr, false);
+  if (pte != NULL && (*pte & PTE_PS) != 0)
+    return (uint8_t *) ptov (*pte & PDMASK) + ((uintptr_t) uaddr & (PTSPAN - 1));
   if (pte != NULL && (*pte & PTE_P) != 0)
     return pte_get_page (*pte) + pg_ofs (uaddr);
   else
@@ -147,6 +180,7 @@ pagedir_clear_page (uint32_t *pd, void *upage)
 
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (is_user_vaddr (upage));
+  ASSERT (!pagedir_is_large (pd, upage));
 
   pte = lookup_page (pd, upage, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
@@ -156,6 +190,57 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Returns true if VADDR lies in a large page in PD. */
+bool
+pagedir_is_large (uint32_t *pd, const void *vaddr)
+{
+  return (pd[pd_no (vaddr)] & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS);
+}
+
+/* Maps the 4 MB of user virtual memory at UPAGE, which must be
+   4 MB aligned, to the 4 MB aligned physical memory at KPAGE with a
+   single large page.  Every page in that range must be mapped to
+   nothing through an existing page table, which is returned so that
+   pagedir_split_large() can put it back. */
+uint32_t *
+pagedir_set_large (uint32_t *pd, void *upage, void *kpage, bool writable,
+                   bool dirty)
+{
+  uint32_t *pde = pd + pd_no (upage);
+  uint32_t *pt;
+
+  ASSERT (((uintptr_t) upage & (PTSPAN - 1)) == 0);
+  ASSERT ((vtop (kpage) & (PTSPAN - 1)) == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT ((*pde & PTE_P) && !(*pde & PTE_PS));
+
+  pt = pde_get_pt (*pde);
+  *pde = vtop (kpage) | PTE_PS | PTE_U | PTE_P
+         | (writable ? PTE_W : 0) | (dirty ? PTE_D : 0);
+  invalidate_pagedir (pd);
+  return pt;
+}
+
+/* Replaces the large page at UPAGE in PD with page table PT,
+   filled in to map the same pages with the same permissions,
+   accessed and dirty bits. */
+void
+pagedir_split_large (uint32_t *pd, void *upage, uint32_t *pt)
+{
+  uint32_t *pde = pd + pd_no (upage);
+  uint32_t flags = *pde & (PTE_W | PTE_A | PTE_D);
+  uint8_t *kpage;
+  size_t i;
+
+  ASSERT (pagedir_is_large (pd, upage));
+
+  kpage = ptov (*pde & PDMASK);
+  for (i = 0; i < PGSIZE / sizeof *pt; i++)
+    pt[i] = pte_create_user (kpage + i * PGSIZE, false) | flags;
+  *pde = pde_create (pt);
+  invalidate_pagedir (pd);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
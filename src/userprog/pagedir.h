@@ -6,6 +6,7 @@
 
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
+void pagedir_destroy_tables (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
 void pagedir_clear_page (uint32_t *pd, void *upage);
@@ -15,6 +16,10 @@ bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 bool pagedir_is_writable (uint32_t *pd, const void *upage);
 void pagedir_set_writable (uint32_t *pd, const void *upage, bool writable);
+bool pagedir_is_large (uint32_t *pd, const void *vaddr);
+uint32_t *pagedir_set_large (uint32_t *pd, void *upage, void *kpage,
+                             bool writable, bool dirty);
+void pagedir_split_large (uint32_t *pd, void *upage, uint32_t *pt);
 void pagedir_activate (uint32_t *pd);
 
 #endif /* userprog/pagedir.h */
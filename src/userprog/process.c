@@ -12,6 +12,7 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
+#include "threads/highmem.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/malloc.h"
@@ -20,15 +21,43 @@
 #include "threads/vaddr.h"
 #include "userprog/syscall.h"
 #include "vm/frame.h"
+#include "vm/largepage.h"
+#include "vm/reclaim.h"
+#include "vm/rss.h"
+#include "vm/vma.h"
+#include "vm/writeback.h"
 #include "devices/swap.h"
 #include "lib/stdio.h"
 
-#define LIMIT_STACK_SIZE 8*1024*1024
 #define PUSH_SIZE 4
 #define PUSHA_SIZE 32
 static thread_func start_process NO_RETURN;
+static thread_func fork_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 
+/* Handed from a forking process to its child. */
+struct fork_info
+  {
+    struct thread *parent;      /* Process being forked. */
+    struct intr_frame if_;      /* Parent's user context at the fork call. */
+  };
+
+/* Creates the relation to a new child of the current thread.
+   thread_create() hands the front relation to the new thread. */
+static struct relation *
+create_child_relation (void)
+{
+  struct relation *child_relation = malloc(sizeof(struct relation));
+  sema_init(&child_relation->sema, 0);
+  lock_init(&child_relation->relation_lock);
+  child_relation->parent_tid = thread_current()->tid;
+  child_relation->parent_alive = true;
+  child_relation->child_alive = true;
+  child_relation->exit_status = -1; // Temporary variable
+  list_push_front(&thread_current()->children_relation_list, &child_relation->elem);
+  return child_relation;
+}
+
 
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -49,14 +78,7 @@ process_execute (const char *file_name)
 
   /* Create a new child parent relation 
      The current thread is the parent, and the created thread is the child */
-  struct relation *child_relation = malloc(sizeof(struct relation));
-  sema_init(&child_relation->sema, 0);
-  lock_init(&child_relation->relation_lock);
-  child_relation->parent_tid = thread_current()->tid;
-  child_relation->parent_alive = true;
-  child_relation->child_alive = true;
-  child_relation->exit_status = -1; // Temporary variable
-  list_push_front(&thread_current()->children_relation_list, &child_relation->elem);
+  struct relation *child_relation = create_child_relation();
 
   /* Process for the thread_name from the file name. */
   size_t i;
@@ -97,6 +119,212 @@ process_execute (const char *file_name)
   return child_relation->child_tid;
 }
 
+/* Creates a child process that is a copy of the current one.  Both
+   processes return from the fork system call; the child sees 0.
+   Resident pages are shared copy-on-write instead of being copied, so
+   the child starts warm without reloading its executable.  Returns the
+   child's thread id, or TID_ERROR if the child cannot be created. */
+tid_t
+process_fork (void)
+{
+  struct thread *cur = thread_current ();
+  struct fork_info *info = malloc (sizeof *info);
+  if (info == NULL)
+    return TID_ERROR;
+
+  /* The system call's interrupt frame sits at the top of the kernel stack. */
+  info->parent = cur;
+  info->if_ = *((struct intr_frame *) ((uint8_t *) cur + PGSIZE) - 1);
+
+  struct relation *child_relation = create_child_relation();
+  tid_t tid = thread_create (cur->name, PRI_DEFAULT, fork_process, info);
+  if (tid == TID_ERROR)
+    {
+      free (info);
+      child_relation->child_alive = false;
+      child_relation->child_tid = TID_ERROR;
+      return TID_ERROR;
+    }
+
+  /* Wait for the child to finish copying our address space */
+  sema_down(&child_relation->sema);
+  return child_relation->child_tid;
+}
+
+/* Duplicates PARENT's spte PSPTE into the current thread's spt.
+   A resident page is mapped read-only into both processes, and a
+   swapped out page shares its swap slot. */
+static bool
+fork_spte (struct thread *parent, struct spt_entry *pspte)
+{
+  struct spt_entry *spte = malloc(sizeof(struct spt_entry));
+  if (spte == NULL)
+    return false;
+
+  spte_initialize(spte, pspte->type, pspte->vaddr, pspte->file, pspte->writable,
+                  false, pspte->offset, pspte->read_bytes, pspte->zero_bytes);
+  spte->swap_slot = pspte->swap_slot;
+
+  struct frame *frame = pspte->frame;
+  if (frame != NULL)
+    {
+      if (!frame_map_page(frame, spte))
+        {
+          free(spte);
+          return false;
+        }
+      if (!pagedir_set_page(thread_current()->pagedir, spte->vaddr, frame->paddr, false))
+        {
+          frame_unmap_page(frame, list_entry(list_back(&frame->map_list), struct frame_map, elem));
+          free(spte);
+          return false;
+        }
+      /* The frame stays dirty for whichever process keeps it. */
+      if (pagedir_is_dirty(parent->pagedir, pspte->vaddr))
+        pagedir_set_dirty(thread_current()->pagedir, spte->vaddr, true);
+      pagedir_set_writable(parent->pagedir, pspte->vaddr, false);
+      spte->is_loaded = true;
+    }
+  else if (spte->type == SWAP)
+    swap_dup(spte->swap_slot);
+
+  insert_spte(&thread_current()->spt, spte);
+  return true;
+}
+
+/* Duplicates PARENT's memory mappings, pointing the already copied
+   sptes at a private handle of each mapped file. */
+static bool
+fork_mmaps (struct thread *parent)
+{
+  struct thread *cur = thread_current();
+  struct list_elem *e;
+
+  for (e = list_begin(&parent->mmap_list); e != list_end(&parent->mmap_list); e = list_next(e))
+    {
+      struct mmap_entry *pmmape = list_entry(e, struct mmap_entry, elem);
+      struct mmap_entry *mmape = malloc(sizeof(struct mmap_entry));
+      if (mmape == NULL)
+        return false;
+
+      mmape->mapid = pmmape->mapid;
+      lock_acquire(&filesys_lock);
+      mmape->file = file_reopen(pmmape->file);
+      lock_release(&filesys_lock);
+      list_init(&mmape->spte_list);
+      mmape->ra = pmmape->ra;
+      mmape->vma = NULL;
+      list_push_back(&cur->mmap_list, &mmape->elem);
+
+      /* madvise() may have split the mapping into several regions. */
+      struct avl_elem *ve;
+      for (ve = pmmape->vma != NULL ? &pmmape->vma->elem : NULL; ve != NULL;
+           ve = avl_next(&parent->vmas, ve))
+        {
+          struct vma *pvma = avl_entry(ve, struct vma, elem);
+          if (pvma->mmape != pmmape)
+            break;
+          struct vma *vma = vma_create(&cur->vmas, pvma->start, pvma->end - pvma->start, FILE,
+                                       mmape->file, pvma->offset, pvma->read_bytes, true);
+          if (vma == NULL)
+            return false;
+          vma->advice = pvma->advice;
+          vma->mmape = mmape;
+          if (mmape->vma == NULL)
+            mmape->vma = vma;
+        }
+
+      struct list_elem *e2;
+      for (e2 = list_begin(&pmmape->spte_list); e2 != list_end(&pmmape->spte_list); e2 = list_next(e2))
+        {
+          struct spt_entry *spte = spt_find(&cur->spt, list_entry(e2, struct spt_entry, mmap_elem)->vaddr);
+          spte->file = mmape->file;
+          list_push_back(&mmape->spte_list, &spte->mmap_elem);
+        }
+    }
+  cur->next_mapid = parent->next_mapid;
+  cur->heap_start = parent->heap_start;
+  cur->brk = parent->brk;
+  return true;
+}
+
+/* Copies PARENT's address space and open files into the current thread. */
+static bool
+fork_address_space (struct thread *parent)
+{
+  struct thread *cur = thread_current();
+  struct hash_iterator i;
+  bool success = true;
+
+  /* Open files are reopened at the same position. */
+  lock_acquire(&filesys_lock);
+  for (int fd = 0; fd < 128; fd++)
+    if (parent->fd[fd] != NULL)
+      {
+        cur->fd[fd] = file_reopen(parent->fd[fd]);
+        if (cur->fd[fd] == NULL)
+          success = false;
+        else
+          file_seek(cur->fd[fd], file_tell(parent->fd[fd]));
+      }
+  lock_release(&filesys_lock);
+  if (!success)
+    return false;
+
+  /* Frames can't be evicted while we hold clock_list_lock.  Pages
+     are shared one by one, so large pages are split first. */
+  lock_acquire(&clock_list_lock);
+  largepage_split_all(parent);
+  hash_first(&i, &parent->spt.table);
+  while (success && hash_next(&i))
+    success = fork_spte(parent, hash_entry(hash_cur(&i), struct spt_entry, elem));
+  lock_release(&clock_list_lock);
+
+  return success && vma_fork(&cur->vmas, &parent->vmas) && fork_mmaps(parent);
+}
+
+/* A thread function that turns a new thread into a copy of the
+   forking process and returns to user mode. */
+static void
+fork_process (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *cur = thread_current();
+  struct intr_frame if_ = info->if_;
+  struct thread *parent = info->parent;
+  free(info);
+
+  spt_init(&cur->spt);
+  vma_init(&cur->vmas);
+  cur->pagedir = pagedir_create();
+  bool success = cur->pagedir != NULL;
+  if (success)
+    {
+      process_activate();
+      success = fork_address_space(parent);
+    }
+
+  if (!success)
+    {
+      for (int fd = 0; fd < 128; fd++)
+        if (cur->fd[fd] != NULL)
+          file_close(cur->fd[fd]);
+      // If the copy failed, child is not alive (quit)
+      cur->parent_relation->child_alive = false;
+      cur->parent_relation->child_tid = -1;
+      thread_exit(); // sema_up for the parent will be called here during process_exit()
+    }
+
+  /* After copying, allow the parent thread to run */
+  cur->parent_relation->child_alive = true;
+  sema_up(&cur->parent_relation->sema);
+
+  /* The child returns 0 from fork. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /* Helper function that decrements the dest by given size, and then writes 0 or src at
    dest depending on the src and returns dest */
 void *
@@ -180,6 +408,7 @@ start_process (void *file_name_)
   strlcpy(thread_name, file_name, i + 1);
   /* Initialize hash table spt. */
   spt_init(&(thread_current() -> spt));
+  vma_init(&(thread_current() -> vmas));
   
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
@@ -260,43 +489,26 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
-  /* When process exits, remove all mmap_entry within mmap_list 
-     and spt_entry within spte_list. */
+  /* Write back what the flush thread left dirty in all the mappings
+     as one sorted batch, then remove every mmap_entry.  Their
+     spt_entries go with the rest of the table. */
+  writeback_exit(cur);
 	for (struct list_elem *elem = list_begin(&cur->mmap_list); elem != list_end(&cur->mmap_list);) {
 		struct list_elem *next_elem = list_next(elem);
 
 		struct mmap_entry *m_entry = list_entry(elem, struct mmap_entry, elem);
-    
-    /* Remove all spt_entry linked to mmap_file's spte_list*/
-    for(struct list_elem * elem2 = list_begin(&m_entry->spte_list);elem2 != list_end(&m_entry->spte_list);)
-    {
-
-      struct list_elem *next_elem2 = list_next(elem2);
-
-      struct spt_entry *spte = list_entry(elem2, struct spt_entry, mmap_elem);
-
-      lock_acquire(&eviction_lock);
-      if(spte->is_loaded && pagedir_is_dirty(thread_current()->pagedir, spte->vaddr)) {
-        file_write_at(spte->file, spte->vaddr, spte->read_bytes, spte->offset);
-      }
-      lock_release(&eviction_lock);
-
-      spte->is_loaded = false;
-      list_remove(elem2);
-
-      /* Delete spte from hash table. */
-      delete_spte(&thread_current()->spt, spte);
-      elem2 = next_elem2;
-    }
 
+    if (m_entry->vma != NULL)
+      vma_remove_mapping(&cur->vmas, m_entry->vma);
     list_remove(&m_entry->elem);
     free(m_entry);
 
 		elem = next_elem;
 	}
 
-  /* After removing mmap_entry and spt_entry, destory hash table spt. */
+  /* Release every page in one pass and destroy hash table spt. */
   spt_destroy(&cur->spt);
+  vma_destroy(&cur->vmas);
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
@@ -309,24 +521,28 @@ process_exit (void)
          process page directory.  We must activate the base page
          directory before destroying the process's page
          directory, or our active page directory will be one
-         that's been freed (and cleared). */
+         that's been freed (and cleared).  The pages it maps went
+         back with the spt, so only the page tables are left. */
       cur->pagedir = NULL;
       pagedir_activate (NULL);
-      pagedir_destroy (pd);
+      pagedir_destroy_tables (pd);
     }
   
   /* Call sema_up for the parent_relation or free the relation 
-     Acquire the relation_lock to prevent race conditions during freeing */
-  lock_acquire(&cur->parent_relation->relation_lock);
-  if (cur->parent_relation->parent_alive) {
-    /* Call sema_up for the parent thread, as it might or will be waiting for it. */
-    sema_up(&cur->parent_relation->sema);
-    cur->parent_relation->child_alive = false;
-    lock_release(&cur->parent_relation->relation_lock);
-  } else {
-    /* If the parent is not alive, free the parent relation. */
-    lock_release(&cur->parent_relation->relation_lock);
-    free(cur->parent_relation);
+     Acquire the relation_lock to prevent race conditions during freeing.
+     Kernel threads have no parent_relation. */
+  if (cur->parent_relation != NULL) {
+    lock_acquire(&cur->parent_relation->relation_lock);
+    if (cur->parent_relation->parent_alive) {
+      /* Call sema_up for the parent thread, as it might or will be waiting for it. */
+      sema_up(&cur->parent_relation->sema);
+      cur->parent_relation->child_alive = false;
+      lock_release(&cur->parent_relation->relation_lock);
+    } else {
+      /* If the parent is not alive, free the parent relation. */
+      lock_release(&cur->parent_relation->relation_lock);
+      free(cur->parent_relation);
+    }
   }
 
   /* Iterate through the children_relation_list 
@@ -535,6 +751,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
                 goto done;
+              /* The heap starts after the highest segment. */
+              if ((uint8_t *) mem_page + read_bytes + zero_bytes > t->heap_start)
+                t->heap_start = (uint8_t *) mem_page + read_bytes + zero_bytes;
             }
           else
             goto done;
@@ -542,6 +761,8 @@ load (const char *file_name, void (**eip) (void), void **esp)
         }
     }
 
+  t->brk = t->heap_start;
+
   /* Set up stack. */
   if (!setup_stack (esp))
     goto done;
@@ -628,37 +849,21 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
-  while (read_bytes > 0 || zero_bytes > 0) 
+  /* The last page of the previous segment may be this segment's
+     first; this segment takes it over. */
+  struct avl *vmas = &thread_current ()->vmas;
+  struct vma *prev = vma_find (vmas, upage);
+  if (prev != NULL)
     {
-      /* Calculate how to fill this page.
-         We will read PAGE_READ_BYTES bytes from FILE
-         and zero the final PAGE_ZERO_BYTES bytes. */
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-  
-      struct spt_entry *spte;
-
-      /* Create spt_entry spte using malloc. */
-      if (!find_spte(upage))
-      {
-        spte = malloc(sizeof(struct spt_entry));
-      } else {
-        spte = find_spte(upage);
-      }
-
-      /* Initialize spt_entry's members. */
-      spte_initialize(spte, ZERO, upage, reopen_file, writable, false, ofs, page_read_bytes, page_zero_bytes);
-      /* Add spt_entry spte to the hash table using insert_spte() function. */
-      insert_spte(&thread_current() -> spt, spte);
-
-      /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      ofs += page_read_bytes;
-      upage += PGSIZE;
+      if (prev->start == upage)
+        vma_remove (vmas, prev);
+      else
+        prev->end = upage;
     }
-  return true;
+
+  /* Pages are read or zeroed on first touch. */
+  return vma_create (vmas, upage, read_bytes + zero_bytes, ZERO, reopen_file,
+                     ofs, read_bytes, writable) != NULL;
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -676,20 +881,17 @@ setup_stack (void **esp)
 
   /* Initialize spt entry, and insert it to the hash table. */
   kframe =  allocate_frame(PAL_USER | PAL_ZERO);
-  if (install_page(((uint8_t *) PHYS_BASE) - PGSIZE, kframe->paddr, true))
+  spte_initialize(spte, SWAP, ((uint8_t *) PHYS_BASE) - PGSIZE, NULL, true, true, 0, 0, 0);
+  if (frame_map_page(kframe, spte)
+      && install_page(((uint8_t *) PHYS_BASE) - PGSIZE, kframe->paddr, true))
   {
     *esp = PHYS_BASE;
-    spte->type = SWAP;
-		spte->vaddr = ((uint8_t *) PHYS_BASE) - PGSIZE;
-		spte->writable = true;
-		spte->is_loaded = true;
-
-    kframe->spte = spte;
     insert_spte(&(thread_current() -> spt), spte);
   }
   else
   {
     free_frame(kframe->paddr);
+    free(spte);
     return false;
   }
   return true;
@@ -738,75 +940,443 @@ bool expand_stack(void *addr)
 
   struct frame *kframe = allocate_frame(PAL_USER | PAL_ZERO);
 
-	spte->type=SWAP;
-	spte->vaddr=pg_round_down(addr);
-	spte->writable=true;
-	spte->is_loaded=true;
-	insert_spte(&thread_current()->spt, spte);
-	kframe->spte=spte;
+	spte_initialize(spte, SWAP, pg_round_down(addr), NULL, true, true, 0, 0, 0);
   
   /* Create page table using install_page, and if install_page
      fails, free the resources. */
-	if(!install_page(spte->vaddr, kframe->paddr, spte->writable))
+	if(!frame_map_page(kframe, spte)
+	   || !install_page(spte->vaddr, kframe->paddr, spte->writable))
 	{
 		free_frame(kframe->paddr);
 		free(spte);
 		return false;
 	}
+	insert_spte(&thread_current()->spt, spte);
 
 	return true;
 }
 
-/* When page fault occurs, allocate physical page. */
-bool page_fault_helper(struct spt_entry *spte)
+/* Counts the pages from SPTE's on that sit in consecutive swap slots,
+   as they do when they were evicted together, up to SWAP_CLUSTER. */
+static size_t
+swap_readahead_size (struct spt_entry *spte)
 {
-  /* Check if the file can be shared */
-  lock_acquire(&clock_list_lock);
+  size_t cnt;
+  if (vma_advice (&thread_current ()->vmas, spte->vaddr) == ADVICE_RANDOM)
+    return 1;
+  for (cnt = 1; cnt < SWAP_CLUSTER; cnt++)
+  {
+    void *vaddr = (uint8_t *) spte->vaddr + cnt * PGSIZE;
+    if (!is_user_vaddr(vaddr))
+      break;
+    struct spt_entry *next = spt_find(&thread_current()->spt, vaddr);
+    if (next == NULL || next->type != SWAP || next->is_loaded
+        || next->swap_slot != spte->swap_slot + cnt)
+      break;
+  }
+  return cnt;
+}
+
+/* Loads SPTE's page and maps it.  WRITE tells whether the page is
+   about to be written.  Must be called with clock_list_lock held,
+   which is dropped while the page is read from disk. */
+static bool
+load_page (struct spt_entry *spte, bool write)
+{
+  /* Reading a page that is all zeros needs no frame of its own. */
+  if (!write && spte->type == ZERO && spte->read_bytes == 0)
+  {
+    lock_acquire(&eviction_lock);
+    bool success = frame_map_zero_page(spte);
+    lock_release(&eviction_lock);
+    return success;
+  }
+
+  /* Check if the page is already in the page cache */
   struct frame* share_page = share_existing_page(spte);
   if (share_page) {
-    /* If the file can be shared, install the page*/
-    if(!install_page(share_page->spte->vaddr, share_page->paddr, share_page->spte->writable)) {
-      /* Remove the share_page if install_page failed. 
-         We shouldn't call free_page because the original shared page shouldn't be removed */
-      delete_frame(share_page);
-      free(share_page);
-      lock_release(&clock_list_lock);
+    /* If the page can be shared, install the page*/
+    if(!install_page(spte->vaddr, share_page->paddr, spte->writable)) {
+      /* Remove only our mapping if install_page failed. 
+         We shouldn't call free_page because the shared page shouldn't be removed */
+      frame_unmap_page(share_page, list_entry(list_back(&share_page->map_list), struct frame_map, elem));
       return false;
     }
-    share_page->spte->is_loaded = true;
-    lock_release(&clock_list_lock);
+    spte->is_loaded = true;
     return true;
   }
 
   struct frame *kframe = allocate_frame(PAL_USER);
-  kframe->spte=spte;
+  if (!frame_map_page(kframe, spte))
+  {
+    free_frame(kframe->paddr);
+    return false;
+  }
 
+  /* The frame is pinned while it is filled, so that nobody evicts,
+     cleans or merges it, and the frame table is free for other faults
+     during the disk read. */
+  size_t swap_cnt = spte->type == SWAP ? swap_readahead_size(spte) : 0;
+  bool loaded = true;
+  frame_pin(kframe);
+  lock_release(&clock_list_lock);
   if (spte->type == ZERO || spte->type == FILE)
-  {
     /* Invoking load_file() loads a file from the disk into physical pages. */
-    if (!load_file(kframe->paddr, spte))
-    {
-      free_frame(kframe->paddr);
-      lock_release(&clock_list_lock);
-      return false;
-    }
-  } 
-  else 
+    loaded = load_file(kframe->paddr, spte);
+  else
+    /* If the type of spte is SWAP, swap in the resources, reading
+       ahead the following pages that were swapped out along with it. */
+    swap_in_cluster(kframe->paddr, spte->swap_slot, swap_cnt);
+  lock_acquire(&clock_list_lock);
+  frame_unpin(kframe);
+
+  if (!loaded)
   {
-    /* If the type of spte is SWAP, swap in the resources. */
-    swap_in(kframe->paddr, spte->swap_slot);
+    free_frame(kframe->paddr);
+    return false;
   }
 
+  /* Publish read-only pages so other processes can share them. */
+  if (pcache_is_cacheable(spte))
+    kframe->pce = pcache_insert(spte, kframe);
+
    /* Maps the virtual address to the physical address in the page table. */
   if (!install_page (spte->vaddr, kframe->paddr, spte->writable))
   {
     free_frame (kframe->paddr);
-    lock_release(&clock_list_lock);
     return false;
   }
   spte->is_loaded=true;
-  
+  return true;
+}
+
+/* Pages of the aligned window around a random fault that are mapped
+   along with it if they cost no I/O. */
+#define FAULT_AROUND_PAGES 8
+
+/* Sequential readahead windows start at READAHEAD_MIN pages and double
+   on every sequential fault up to READAHEAD_MAX pages. */
+#define READAHEAD_MIN 4
+#define READAHEAD_MAX 32
+
+static unsigned long long fault_around_cnt;   /* Pages mapped around faults */
+static unsigned long long readahead_cnt;      /* Pages read ahead */
+
+/* Returns the readahead state of the mapping holding file page SPTE. */
+static struct readahead *
+spte_readahead (struct spt_entry *spte)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+
+  if (spte->type == FILE)
+    for (e = list_begin (&cur->mmap_list); e != list_end (&cur->mmap_list);
+         e = list_next (e))
+      {
+        struct mmap_entry *mmape = list_entry (e, struct mmap_entry, elem);
+        if (mmape->file == spte->file)
+          return &mmape->ra;
+      }
+  return &cur->exec_ra;
+}
+
+/* Maps the file page at VADDR ahead of use.  Pages in the page cache
+   and zero fill pages are always mapped; others only if ALLOW_IO and
+   memory is not short.  Nothing is mapped for a process at its hard
+   resident limit.  Returns true if the page is now mapped. */
+static bool
+prefault_page (void *vaddr, bool allow_io)
+{
+  if (!is_user_vaddr (vaddr))
+    return false;
+  struct spt_entry *spte = find_spte (vaddr);
+  if (spte == NULL || spte->type == SWAP)
+    return false;
+  if (spte->is_loaded)
+    return true;
+
+  bool cheap = (spte->type == ZERO && spte->read_bytes == 0)
+               || (pcache_is_cacheable (spte) && pcache_lookup (spte) != NULL);
+  if (!cheap && (!allow_io || frame_free_cnt () <= READAHEAD_MAX))
+    return false;
+  if (rss_at_hard_limit (thread_current ()))
+    return false;
+  return load_page (spte, false);
+}
+
+/* Puts the pages READAHEAD_MAX to 2 * READAHEAD_MAX pages behind the
+   fault at VADDR first in line for eviction, since a reader that
+   declared itself sequential won't come back for them. */
+static void
+drop_behind (uint8_t *vaddr)
+{
+  size_t i;
+
+  for (i = READAHEAD_MAX; i < 2 * READAHEAD_MAX; i++)
+    {
+      if ((uintptr_t) vaddr < i * PGSIZE)
+        break;
+      struct spt_entry *behind = spt_find (&thread_current ()->spt, vaddr - i * PGSIZE);
+      if (behind != NULL && behind->frame != NULL
+          && vma_advice (&thread_current ()->vmas, behind->vaddr) == ADVICE_SEQUENTIAL)
+        reclaim_deactivate (behind->frame);
+    }
+}
+
+/* Maps more of the mapping around file page SPTE, which was just
+   faulted in.  A fault right where the last one left off is taken as
+   sequential access and reads ahead a growing window of pages; any
+   other fault maps only what is cheap in the aligned window around
+   it.  Pages advised sequential always read ahead the largest window,
+   and pages advised random never map anything around.  Must be called
+   with clock_list_lock held. */
+static void
+fault_around (struct spt_entry *spte)
+{
+  struct readahead *ra = spte_readahead (spte);
+  uint8_t *vaddr = spte->vaddr;
+  enum spt_advice advice = vma_advice (&thread_current ()->vmas, vaddr);
+  size_t i;
+
+  if (advice == ADVICE_RANDOM)
+    return;
+
+  if (advice == ADVICE_SEQUENTIAL)
+    drop_behind (vaddr);
+
+  if (vaddr == ra->next || advice == ADVICE_SEQUENTIAL)
+    {
+      ra->window = ra->window == 0 ? READAHEAD_MIN : ra->window * 2;
+      if (ra->window > READAHEAD_MAX || advice == ADVICE_SEQUENTIAL)
+        ra->window = READAHEAD_MAX;
+      for (i = 1; i < ra->window; i++)
+        {
+          struct spt_entry *next = find_spte (vaddr + i * PGSIZE);
+          bool loaded = next != NULL && next->is_loaded;
+          if (!prefault_page (vaddr + i * PGSIZE, true))
+            break;
+          if (!loaded)
+            readahead_cnt++;
+        }
+    }
+  else
+    {
+      uint8_t *start = (uint8_t *) ((uintptr_t) vaddr
+                                    & ~(uintptr_t) (FAULT_AROUND_PAGES * PGSIZE - 1));
+      ra->window = 0;
+      for (i = 0; i < FAULT_AROUND_PAGES; i++)
+        {
+          uint8_t *page = start + i * PGSIZE;
+          struct spt_entry *next = find_spte (page);
+          if (page != vaddr && next != NULL && !next->is_loaded
+              && prefault_page (page, false))
+            fault_around_cnt++;
+        }
+    }
+
+  /* A sequential reader faults next on the first page not mapped. */
+  for (i = 1; i < READAHEAD_MAX; i++)
+    {
+      struct spt_entry *next = find_spte (vaddr + i * PGSIZE);
+      if (next == NULL || !next->is_loaded)
+        break;
+    }
+  ra->next = vaddr + i * PGSIZE;
+}
+
+/* Prints fault-around and readahead statistics. */
+void
+fault_around_print_stats (void)
+{
+  printf ("Fault-around: %llu pages mapped around faults, %llu pages read ahead\n",
+          fault_around_cnt, readahead_cnt);
+}
+
+/* Brings SPTE's page in ahead of use for madvise(MADV_WILLNEED), as
+   long as memory is not short.  Returns false once it is. */
+bool
+page_prefetch (struct spt_entry *spte)
+{
+  bool success = true;
+
+  lock_acquire (&clock_list_lock);
+  if (!spte->is_loaded)
+    {
+      if (frame_free_cnt () <= READAHEAD_MAX
+          || rss_at_hard_limit (thread_current ()))
+        success = false;
+      else
+        success = load_page (spte, false);
+    }
+  lock_release (&clock_list_lock);
+  return success;
+}
+
+/* Tells how a fault on SPTE's page, a write if WRITE, is going to be
+   served, for the VM statistics. */
+enum vm_event page_fault_event(struct spt_entry *spte, bool write)
+{
+  if (spte->type == SWAP)
+    return VM_FAULT_SWAP;
+  if (!write && spte->type == ZERO && spte->read_bytes == 0)
+    return VM_FAULT_ZERO;
+
+  lock_acquire(&clock_list_lock);
+  bool shared = pcache_is_cacheable(spte) && pcache_lookup(spte) != NULL;
+  lock_release(&clock_list_lock);
+  if (shared)
+    return VM_FAULT_SHARED;
+  return spte->type == FILE || spte->read_bytes > 0 ? VM_FAULT_FILE : VM_FAULT_ZERO;
+}
+
+/* When page fault occurs, allocate physical page.
+   WRITE tells whether the faulting access was a write. */
+bool page_fault_helper(struct spt_entry *spte, bool write)
+{
+  lock_acquire(&clock_list_lock);
+
+  /* The page was mapped again while the fault waited for the lock,
+     as when compaction moves a frame. */
+  if (spte->is_loaded && pagedir_get_page(thread_current()->pagedir, spte->vaddr) != NULL)
+  {
+    lock_release(&clock_list_lock);
+    return true;
+  }
+
+  bool success = load_page(spte, write);
+
+  /* File backed pages bring their neighbours along, and a fully
+     populated region of anonymous memory gets a large page. */
+  if (success && spte->type != SWAP)
+    fault_around(spte);
+  if (success && spte->type != FILE)
+    largepage_try_promote(spte);
+
+  lock_release(&clock_list_lock);
+  return success;
+}
+
+/* Makes SPTE's page present, and privately writable if WRITE, and
+   pins its frame so that the kernel can access the page through its
+   user address until page_unpin().  A large page holding the page is
+   split first, since only small frames can be pinned. */
+bool page_pin(struct spt_entry *spte, bool write)
+{
+  uint32_t *pd = thread_current()->pagedir;
+
+  lock_acquire(&clock_list_lock);
+  for (;;)
+  {
+    largepage_split_at(thread_current(), spte->vaddr);
+    if (!spte->is_loaded)
+    {
+      if (!load_page(spte, write))
+      {
+        lock_release(&clock_list_lock);
+        return false;
+      }
+    }
+    else if (write && !pagedir_is_writable(pd, spte->vaddr))
+    {
+      /* Kernel writes ignore write protection, so a copy-on-write
+         or zero page must be made private before it is written. */
+      lock_release(&clock_list_lock);
+      if (!page_cow_helper(spte))
+        return false;
+      lock_acquire(&clock_list_lock);
+    }
+    else
+      break;
+  }
+
+  /* A page reading as the shared zero page has no frame to pin. */
+  if (spte->frame != NULL)
+    frame_pin(spte->frame);
   lock_release(&clock_list_lock);
+  return true;
+}
 
+/* Undoes page_pin() of SPTE's page. */
+void page_unpin(struct spt_entry *spte)
+{
+  lock_acquire(&clock_list_lock);
+  if (spte->frame != NULL)
+    frame_unpin(spte->frame);
+  lock_release(&clock_list_lock);
+}
+
+/* Handles a write to a present read-only page that SPTE allows writing,
+   which means the page is shared copy-on-write with a forked process.
+   The last process left sharing the frame just takes it over. */
+bool page_cow_helper(struct spt_entry *spte)
+{
+  lock_acquire(&clock_list_lock);
+  uint32_t *pd = thread_current()->pagedir;
+  struct frame *old = spte->frame;
+
+  /* The first write to the shared zero page gets a zeroed frame. */
+  if (old == NULL && pagedir_get_page(pd, spte->vaddr) == zero_page)
+  {
+    lock_acquire(&eviction_lock);
+    pagedir_clear_page(pd, spte->vaddr);
+    lock_release(&eviction_lock);
+    spte->is_loaded = false;
+    lock_release(&clock_list_lock);
+    return page_fault_helper(spte, true);
+  }
+
+  if (old != NULL && list_size(&old->map_list) == 1)
+  {
+    pagedir_set_writable(pd, spte->vaddr, true);
+    lock_release(&clock_list_lock);
+    return true;
+  }
+
+  /* Allocating may evict the shared frame, in which case the page is
+     simply faulted back in as a private page. */
+  struct frame *kframe = allocate_frame(PAL_USER);
+  old = spte->frame;
+  if (old == NULL)
+  {
+    free_frame(kframe->paddr);
+    lock_release(&clock_list_lock);
+    return page_fault_helper(spte, true);
+  }
+  void *to = kmap (kframe->paddr), *from = kmap (old->paddr);
+  memcpy (to, from, PGSIZE);
+  kunmap (from);
+  kunmap (to);
+
+  /* Drop our mapping of the shared frame. */
+  struct list_elem *elem;
+  for (elem = list_begin(&old->map_list); elem != list_end(&old->map_list); elem = list_next(elem))
+  {
+    struct frame_map *map = list_entry(elem, struct frame_map, elem);
+    if (map->pagedir == pd)
+    {
+      frame_unmap_page(old, map);
+      break;
+    }
+  }
+
+  /* A single remaining mapper owns the old frame outright. */
+  if (list_size(&old->map_list) == 1)
+  {
+    struct frame_map *map = list_entry(list_front(&old->map_list), struct frame_map, elem);
+    if (map->spte->writable)
+      pagedir_set_writable(map->pagedir, map->spte->vaddr, true);
+  }
+
+  if (!frame_map_page(kframe, spte)
+      || !install_page(spte->vaddr, kframe->paddr, spte->writable))
+  {
+    free_frame(kframe->paddr);
+    lock_release(&clock_list_lock);
+    return false;
+  }
+  pagedir_set_dirty(pd, spte->vaddr, true);
+  spte->is_loaded = true;
+
+  lock_release(&clock_list_lock);
   return true;
 }
@@ -5,13 +5,23 @@
 #include "userprog/pagedir.h"
 #include "vm/page.h"
 
+/* Address space below PHYS_BASE kept free for the stack to grow into. */
+#define LIMIT_STACK_SIZE (8*1024*1024)
+
 tid_t process_execute (const char *file_name);
+tid_t process_fork (void);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
 void* stack_element (void *write_dest, void *write_src, int size);
 bool check_stack_esp(void *addr, void *esp);
 bool expand_stack(void *addr);
-bool page_fault_helper(struct spt_entry *spte);
+bool page_fault_helper(struct spt_entry *spte, bool write);
+enum vm_event page_fault_event(struct spt_entry *spte, bool write);
+bool page_prefetch (struct spt_entry *spte);
+void fault_around_print_stats (void);
+bool page_cow_helper(struct spt_entry *spte);
+bool page_pin(struct spt_entry *spte, bool write);
+void page_unpin(struct spt_entry *spte);
 
 #endif /* userprog/process.h */
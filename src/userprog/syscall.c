@@ -1,5 +1,6 @@
 #include "userprog/syscall.h"
 #include "lib/user/syscall.h"
+#include <round.h>
 #include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
@@ -12,6 +13,9 @@
 #include "devices/input.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/vma.h"
+#include "vm/vmstat.h"
+#include "vm/writeback.h"
 #include "devices/swap.h"
 #include "lib/kernel/stdio.h"
 #include "lib/stdio.h"
@@ -39,11 +43,16 @@ uint32_t sys_tell (uint32_t *esp);
 uint32_t sys_close (uint32_t *esp);
 uint32_t sys_mmap (uint32_t *esp);
 uint32_t sys_munmap (uint32_t *esp);
+uint32_t sys_fork (uint32_t *esp);
+uint32_t sys_madvise (uint32_t *esp);
+uint32_t sys_msync (uint32_t *esp);
+uint32_t sys_vmstat (uint32_t *esp);
+uint32_t sys_brk (uint32_t *esp);
 
 
 void exit (int status);
 
-static const int syscall_args[] = {0, 1, 1, 1, 2, 1, 1, 1, 3, 3, 2, 1, 1, 2, 1};
+static const int syscall_args[] = {0, 1, 1, 1, 2, 1, 1, 1, 3, 3, 2, 1, 1, 2, 1, 0, 3, 3, 2, 1};
 static uint32_t (*syscall_func[]) (uint32_t *esp) = 
 {
   sys_halt,
@@ -60,34 +69,74 @@ static uint32_t (*syscall_func[]) (uint32_t *esp) =
   sys_tell,
   sys_close,
   sys_mmap,
-  sys_munmap
+  sys_munmap,
+  sys_fork,
+  sys_madvise,
+  sys_msync,
+  sys_vmstat,
+  sys_brk
 };
 static void syscall_handler (struct intr_frame *f);
 void syscall_init(void);
 
-/* Checks if address exists in the spt_entry 
-   and checks if buffer's address is valid address. */
+/* Most pages of a user buffer pinned at once.  Larger buffers are
+   pinned and transferred a chunk at a time, so that one read() or
+   write() never pins more frames than memory holds. */
+#define PIN_CHUNK_PAGES 16
+
+/* Returns how many of the SIZE bytes at BUFFER to pin and transfer
+   in one go. */
+static unsigned
+pin_chunk_size(const void *buffer, unsigned size)
+{
+    unsigned room = PIN_CHUNK_PAGES * PGSIZE - pg_ofs(buffer);
+    return size < room ? size : room;
+}
+
+/* Undoes pin_buffer() for the pages holding the SIZE bytes at BUFFER. */
+static void
+unpin_buffer(const void *buffer, unsigned size)
+{
+    const uint8_t *page;
+    const uint8_t *end = (const uint8_t *) buffer + size;
+
+    if (size == 0)
+        return;
+    for (page = pg_round_down(buffer); page < end; page += PGSIZE)
+        page_unpin(spt_find(&thread_current()->spt, (void *) page));
+}
+
+/* Checks that the SIZE bytes at BUFFER are user memory, writable if
+   WRITE, growing the stack if they lie just below ESP.  Each page is
+   looked up, faulted in and pinned once, so it stays put while the
+   kernel accesses it.  Kills the process if the buffer is invalid;
+   otherwise unpin_buffer() must follow.  Buffers that may be large
+   are pinned a pin_chunk_size() at a time. */
 static void
-check_spte_address(void *str, unsigned size, void *esp)
+pin_buffer(const void *buffer, unsigned size, bool write, void *esp)
 {
-    for (uint32_t i = 0; i < size; i++)
+    const uint8_t *start = buffer;
+    const uint8_t *end = start + size;
+    const uint8_t *addr;
+
+    if (end < start)
+        exit(EXIT_ERROR);
+    for (addr = start; addr < end; addr = pg_round_down(addr) + PGSIZE)
     {
-        if (!is_user_vaddr(str + i))
+        struct spt_entry *spte = NULL;
+        if (is_user_vaddr(addr))
         {
-            exit(EXIT_ERROR);
+            spte = find_spte((void *) addr);
+            if (spte == NULL && check_stack_esp((void *) addr, esp)
+                && expand_stack((void *) addr))
+                spte = find_spte((void *) addr);
         }
 
-        struct spt_entry *spte = find_spte(str + i);
-        if (spte == NULL)
+        if (spte == NULL || (write && !spte->writable) || !page_pin(spte, write))
         {
-            if (!check_stack_esp(str + i, esp))
-                exit(EXIT_ERROR);
-            expand_stack(str + i);
-            spte = find_spte(str + i);
-        }
-
-        if (spte == NULL)
+            unpin_buffer(start, addr - start);
             exit(EXIT_ERROR);
+        }
     }
 }
 
@@ -99,16 +148,15 @@ syscall_init (void)
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
-/* Checks if virtual address is correct. */
+/* Checks if virtual address is correct.  The words at ESP only
+   need to belong to the process; reading them faults them in. */
 static void check_pointer(uint32_t *esp, int args_num)
 {
-  lock_acquire(&eviction_lock);
-  if (!pagedir_get_page(thread_current() -> pagedir, esp))
+  if (!is_user_vaddr(esp + args_num) || find_spte(esp) == NULL
+      || find_spte(esp + args_num) == NULL)
   {
-    lock_release(&eviction_lock);
     exit(EXIT_ERROR);
   }
-  lock_release(&eviction_lock);
 
   for (int i = 0; i <= args_num; ++i)
   {
@@ -260,27 +308,48 @@ uint32_t sys_read (uint32_t *esp)
   int fd = (int) esp[1];
   void *buffer = (void *) esp[2];
   unsigned size = (unsigned) esp[3];
-  check_spte_address(buffer, size, esp);
+  int read_val;
+
+  if (fd != STDIN && (fd < FD_BEGIN || fd >= FD_END))
+    exit(EXIT_ERROR);
 
   /* If fd == STDIN, reads from the keyboard using input_getc() */
   if (fd == STDIN) {
-    unsigned i;
+    const uint8_t *p;
+    unsigned chunk, i;
+    for (p = buffer; p < (const uint8_t *) buffer + size; p += chunk) {
+      chunk = pin_chunk_size(p, (const uint8_t *) buffer + size - p);
+      pin_buffer(p, chunk, true, esp);
+      unpin_buffer(p, chunk);
+    }
     for (i = 0; input_getc() || i <= size; ++i) {
 
     }
-    return i;
-  } /* If fd is between FD_BEGIN and FD_END, reads size bytes from the file open as fd into buffer. */
-  else if (fd >= FD_BEGIN && fd < FD_END)
-  {
-    lock_acquire(&filesys_lock);
-    int read_val = file_read(thread_current() -> fd[fd], buffer, size);
-    lock_release(&filesys_lock);
-    return read_val;
-  } /* Otherwise, exit. */
+    read_val = i;
+  } /* Otherwise, reads size bytes from the file open as fd into buffer,
+       a chunk at a time. */
   else
   {
-    exit(EXIT_ERROR);
+    uint8_t *p = buffer;
+    unsigned done = 0;
+    while (done < size)
+    {
+      unsigned chunk = pin_chunk_size(p, size - done);
+      pin_buffer(p, chunk, true, esp);
+      lock_acquire(&filesys_lock);
+      int cnt = file_read(thread_current() -> fd[fd], p, chunk);
+      lock_release(&filesys_lock);
+      unpin_buffer(p, chunk);
+      if (cnt <= 0)
+        break;
+      done += cnt;
+      p += cnt;
+      if ((unsigned) cnt < chunk)
+        break;
+    }
+    read_val = done;
   }
+  return read_val;
 }
 
 uint32_t sys_write (uint32_t *esp)
@@ -288,28 +357,47 @@ uint32_t sys_write (uint32_t *esp)
   int fd = (int) esp[1];
   const void *buffer = (const void *) esp[2];
   unsigned size = (unsigned) esp[3];
-  check_spte_address((void *) buffer, size, esp);
+  int write_val;
 
-  /* If fd == STDOUT, writes to the console using putbuf(). */
-  if (fd == STDOUT) 
-  {
-    lock_acquire(&filesys_lock);
-    putbuf(buffer, size);
-    lock_release(&filesys_lock);
-    return size;
-  } /* If fd is between FD_BEGIN and FD_END, writes size bytes from buffer to the open file fd. */
-  else if (fd >= FD_BEGIN && fd < FD_END)
+  if (fd != STDOUT && (fd < FD_BEGIN || fd >= FD_END))
+    exit(EXIT_ERROR);
+
+  /* Writes size bytes from buffer a chunk at a time: to the console
+     using putbuf() if fd == STDOUT, otherwise to the open file fd. */
+  const uint8_t *p = buffer;
+  unsigned done = 0;
+  while (done < size)
   {
+    unsigned chunk = pin_chunk_size(p, size - done);
+    int cnt = chunk;
+    off_t pos = 0;
+    pin_buffer(p, chunk, false, esp);
     lock_acquire(&filesys_lock);
-    int write_val = file_write(thread_current() -> fd[fd], buffer, size);
+    if (fd == STDOUT)
+      putbuf((const char *) p, chunk);
+    else
+    {
+      pos = file_tell(thread_current() -> fd[fd]);
+      cnt = file_write(thread_current() -> fd[fd], p, chunk);
+    }
     lock_release(&filesys_lock);
-    return write_val;
-  } /* Otherwise, exit. */
-  else
-  {
-    exit(EXIT_ERROR);
+    unpin_buffer(p, chunk);
+    /* Shared copies of the pages just written are out of date. */
+    if (fd != STDOUT && cnt > 0)
+    {
+      lock_acquire(&clock_list_lock);
+      pcache_invalidate(thread_current() -> fd[fd], pos, cnt);
+      lock_release(&clock_list_lock);
+    }
+    if (cnt <= 0)
+      break;
+    done += cnt;
+    p += cnt;
+    if ((unsigned) cnt < chunk)
+      break;
   }
-  return -1;
+  write_val = done;
+  return write_val;
 }
 
 uint32_t sys_seek (uint32_t *esp)
@@ -363,12 +451,21 @@ uint32_t sys_mmap(uint32_t *esp)
   size_t offset = 0;
 
   /* Invalid cases. */
-  if (fp == NULL || pg_ofs(addr) != 0 || !addr || !is_user_vaddr(addr) || find_spte(addr)
+  if (fp == NULL || pg_ofs(addr) != 0 || !addr || !is_user_vaddr(addr)
       || fd == 0 || fd == 1)
   {
     return -1;
   }
 
+  /* The mapping must not overlap an existing region or the stack. */
+  int read_bytes_size = file_length(fp);
+  if (read_bytes_size > 0
+      && ((uint8_t *) addr + read_bytes_size > (uint8_t *) PHYS_BASE - LIMIT_STACK_SIZE
+          || vma_overlaps(&thread_current() -> vmas, addr, read_bytes_size)))
+  {
+    return -1;
+  }
+
   /* Initialize mmap_entry, and if failed, return -1
      This is done separately from the invalid cases, as mmape must be freed. */
   struct mmap_entry *mmape = malloc(sizeof(struct mmap_entry));
@@ -377,52 +474,34 @@ uint32_t sys_mmap(uint32_t *esp)
     return -1;
   }
 
-  mapid = thread_current() -> next_mapid++;
-  mmape->mapid = mapid;
-
   lock_acquire(&filesys_lock);
   mmape->file = file_reopen(fp);
   lock_release(&filesys_lock);
 
-  list_init (&mmape->spte_list);
-  list_push_back(&thread_current() -> mmap_list, &mmape->elem);
-
-  /* spt_entry Initialization. */
-  int read_bytes_size = file_length(mmape -> file);
-
-  int check_bytes_size = read_bytes_size;
-  int *check_addr = addr;
-  int check_offset = offset;
-  
-  /* Check if range of to-be-mapped pages would overlap with any existing mapped pages */
-  while(check_bytes_size > 0) 
+  /* Pages are read from the file on first touch. */
+  mmape->vma = NULL;
+  if (read_bytes_size > 0)
   {
-    size_t page_read_bytes = check_bytes_size < PGSIZE ? check_bytes_size : PGSIZE;
-
-    if (find_spte(check_addr)) {
+    mmape->vma = vma_create(&thread_current() -> vmas, addr, read_bytes_size, FILE,
+                            mmape->file, offset, read_bytes_size, true);
+    if (mmape->vma == NULL)
+    {
+      lock_acquire(&filesys_lock);
+      file_close(mmape->file);
+      lock_release(&filesys_lock);
       free(mmape);
-      return EXIT_ERROR;
-    } 
+      return -1;
+    }
+    mmape->vma->mmape = mmape;
+  }
 
-    check_addr += PGSIZE;
-    check_offset += page_read_bytes;
-    check_bytes_size -= page_read_bytes;
-  } 
+  mapid = thread_current() -> next_mapid++;
+  mmape->mapid = mapid;
 
-  while(read_bytes_size > 0)
-  {
-    size_t page_read_bytes = read_bytes_size < PGSIZE ? read_bytes_size : PGSIZE;
-    size_t page_zero_bytes = PGSIZE - page_read_bytes;
-  
-    struct spt_entry *spte = malloc(sizeof(struct spt_entry));
-    spte_initialize(spte, FILE, addr, mmape->file, true, false, offset, page_read_bytes, page_zero_bytes);
-    list_push_back(&(mmape->spte_list), &(spte->mmap_elem));
-    insert_spte(&thread_current() -> spt, spte);
-
-    addr += PGSIZE;
-    offset += page_read_bytes;
-    read_bytes_size -= page_read_bytes;
-  }
+  list_init (&mmape->spte_list);
+  mmape->ra.next = NULL;
+  mmape->ra.window = 0;
+  list_push_back(&thread_current() -> mmap_list, &mmape->elem);
   return mapid;
 }
 
@@ -449,6 +528,11 @@ uint32_t sys_munmap(uint32_t *esp)
   if (mmape == NULL)
     return VOID_RET;
 
+  /* Writes the pages still dirty back to the file. */
+  if (mmape->vma != NULL)
+    writeback_mapping(mmape, mmape->vma->start,
+                      vma_mapping_end(&cur->vmas, mmape->vma), true);
+
   /* Delte all spt_entry connected to mmap_entry's spte_list. */
   struct list_elem *e2 = list_begin(&mmape->spte_list);
 
@@ -457,13 +541,6 @@ uint32_t sys_munmap(uint32_t *esp)
     struct list_elem *next_e2 = list_next(e2);
     struct spt_entry *spte = list_entry(e2, struct spt_entry, mmap_elem);
     
-    /* Writes the contents of the memory to the disk if a page exists and is dirty. */
-    lock_acquire(&eviction_lock);
-    if (spte->is_loaded && pagedir_is_dirty(thread_current()->pagedir, spte->vaddr)) {
-      file_write_at(spte->file, spte->vaddr, spte->read_bytes, spte->offset);
-    }
-    lock_release(&eviction_lock);
-    
     spte->is_loaded = false;
     list_remove(e2);
     
@@ -471,7 +548,179 @@ uint32_t sys_munmap(uint32_t *esp)
     e2 = next_e2;
   }
 
+  if (mmape->vma != NULL)
+    vma_remove_mapping(&cur->vmas, mmape->vma);
   list_remove(&mmape->elem);
   free(mmape);
   return VOID_RET;
 }
+
+/* Clones the current process, sharing its memory copy-on-write. */
+uint32_t sys_fork (uint32_t *esp UNUSED)
+{
+  return process_fork();
+}
+
+/* Gives the VM a hint about how the pages in [ADDR, ADDR + LENGTH)
+   will be used.  Access pattern hints are kept on the regions, which
+   are split where the range ends inside one; stack pages belong to no
+   region and ignore them.  WILLNEED and DONTNEED act on the pages
+   touched so far, the only ones with anything to bring in or throw
+   away.  Returns 0, or -1 if ADDR is not page aligned, ADVICE is
+   unknown, part of the range is not mapped or memory ran out. */
+uint32_t sys_madvise (uint32_t *esp)
+{
+  uint8_t *addr = (uint8_t *) esp[1];
+  uint8_t *end = addr + ROUND_UP ((size_t) esp[2], PGSIZE);
+  int advice = (int) esp[3];
+  struct thread *cur = thread_current ();
+  uint8_t *p;
+
+  if (pg_ofs (addr) != 0 || advice < MADV_NORMAL || advice > MADV_DONTNEED
+      || end < addr || (end > addr && !is_user_vaddr (end - 1)))
+    return EXIT_ERROR;
+  for (p = addr; p < end; )
+    {
+      struct vma *vma = vma_find (&cur->vmas, p);
+      if (vma != NULL)
+        p = vma->end;
+      else if (spt_find (&cur->spt, p) != NULL)
+        p += PGSIZE;
+      else
+        return EXIT_ERROR;
+    }
+
+  switch (advice)
+    {
+      case MADV_NORMAL:
+        return vma_advise (&cur->vmas, addr, end, ADVICE_NORMAL) ? VOID_RET : EXIT_ERROR;
+      case MADV_RANDOM:
+        return vma_advise (&cur->vmas, addr, end, ADVICE_RANDOM) ? VOID_RET : EXIT_ERROR;
+      case MADV_SEQUENTIAL:
+        return vma_advise (&cur->vmas, addr, end, ADVICE_SEQUENTIAL) ? VOID_RET : EXIT_ERROR;
+    }
+
+  for (p = addr; p < end; p += PGSIZE)
+    {
+      struct spt_entry *spte = spt_find (&cur->spt, p);
+      if (spte == NULL)
+        continue;
+      if (advice == MADV_DONTNEED)
+        spte_discard (spte);
+      else if (!page_prefetch (spte))
+        break;          /* Memory is getting short. */
+    }
+  return VOID_RET;
+}
+
+/* Writes the dirty pages of the memory mappings in [ADDR, ADDR + LENGTH)
+   back to their files, before returning with MS_SYNC or in the
+   background with MS_ASYNC.  Returns 0, or -1 if ADDR is not page
+   aligned, FLAGS is not exactly one of the two or part of the range
+   is not a memory mapping. */
+uint32_t sys_msync (uint32_t *esp)
+{
+  uint8_t *addr = (uint8_t *) esp[1];
+  uint8_t *end = addr + ROUND_UP ((size_t) esp[2], PGSIZE);
+  int flags = (int) esp[3];
+  struct thread *cur = thread_current ();
+  uint8_t *p;
+
+  if (pg_ofs (addr) != 0 || (flags != MS_SYNC && flags != MS_ASYNC)
+      || end < addr || !is_user_vaddr (end - 1))
+    return EXIT_ERROR;
+  for (p = addr; p < end; )
+    {
+      struct vma *vma = vma_find (&cur->vmas, p);
+      if (vma == NULL || vma->mmape == NULL)
+        return EXIT_ERROR;
+      p = vma->end;
+    }
+
+  for (p = addr; p < end; )
+    {
+      struct vma *vma = vma_find (&cur->vmas, p);
+      writeback_mapping (vma->mmape, p, end < vma->end ? end : vma->end,
+                         flags == MS_SYNC);
+      p = vma->end;
+    }
+  return VOID_RET;
+}
+
+/* Copies the VM statistics of this process, for WHICH VMSTAT_SELF,
+   or of the whole system, for VMSTAT_ALL, into the buffer at STATS.
+   Returns 0, or -1 if WHICH is neither. */
+uint32_t sys_vmstat (uint32_t *esp)
+{
+  int which = (int) esp[1];
+  struct vmstat *stats = (struct vmstat *) esp[2];
+  struct vmstat copy;
+
+  if (which != VMSTAT_SELF && which != VMSTAT_ALL)
+    return EXIT_ERROR;
+  vmstat_get (which == VMSTAT_SELF ? thread_current () : NULL, &copy);
+
+  pin_buffer (stats, sizeof *stats, true, esp);
+  memcpy (stats, &copy, sizeof *stats);
+  unpin_buffer (stats, sizeof *stats);
+  return VOID_RET;
+}
+
+/* Moves the program break, the end of the heap, to ADDR.  The heap
+   is a region of zero fill pages starting after the executable's
+   segments; pages added to it are zeroed on first touch, and pages
+   it gives back are freed along with their frames and swap slots.
+   Returns the new break, or the old one if ADDR is below the start of
+   the heap or would take the heap into another region or the stack's
+   reserve.  brk(NULL) thus returns the break. */
+uint32_t sys_brk (uint32_t *esp)
+{
+  uint8_t *addr = (uint8_t *) esp[1];
+  struct thread *cur = thread_current ();
+  uint8_t *old_end = (uint8_t *) ROUND_UP ((uintptr_t) cur->brk, PGSIZE);
+  uint8_t *new_end = (uint8_t *) ROUND_UP ((uintptr_t) addr, PGSIZE);
+  struct vma *heap = NULL;
+  uint8_t *p;
+
+  if (addr < cur->heap_start
+      || new_end > (uint8_t *) PHYS_BASE - LIMIT_STACK_SIZE)
+    return (uint32_t) cur->brk;
+  /* The heap may have been split by madvise(); it grows and shrinks
+     at its last piece. */
+  if (old_end > cur->heap_start)
+    heap = vma_find (&cur->vmas, old_end - 1);
+
+  if (new_end > old_end)
+    {
+      if (vma_overlaps (&cur->vmas, old_end, new_end - old_end))
+        return (uint32_t) cur->brk;
+      if (heap != NULL)
+        heap->end = new_end;
+      else if (vma_create (&cur->vmas, cur->heap_start,
+                           new_end - cur->heap_start, ZERO, NULL, 0, 0,
+                           true) == NULL)
+        return (uint32_t) cur->brk;
+    }
+  else if (new_end < old_end)
+    {
+      for (p = new_end; p < old_end; p += PGSIZE)
+        {
+          struct spt_entry *spte = spt_find (&cur->spt, p);
+          if (spte != NULL)
+            delete_spte (&cur->spt, spte);
+        }
+      while (heap->start >= new_end)
+        {
+          uint8_t *start = heap->start;
+          vma_remove (&cur->vmas, heap);
+          heap = start > new_end ? vma_find (&cur->vmas, start - 1) : NULL;
+          if (heap == NULL)
+            break;
+        }
+      if (heap != NULL)
+        heap->end = new_end;
+    }
+
+  cur->brk = addr;
+  return (uint32_t) addr;
+}
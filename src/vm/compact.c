@@ -0,0 +1,249 @@
+#include "vm/compact.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/highmem.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/largepage.h"
+
+/* Memory compaction.  When no run of free user pages is long enough
+   for a multi-page allocation, compaction picks a window of the user
+   pool whose used pages all hold frames it can move, copies each of
+   those frames to a free page outside the window, and points the
+   frame's mappings at the copy.  The struct frame itself stays, so the
+   policy queues, page cache, merge table and write-back queue never
+   notice; only frame->paddr and the page table entries change.
+
+   Pinned frames and user pages allocated outside the frame table, such
+   as large pages and the swap cache, cannot move, so windows holding
+   them are never picked.  Kernel pool pages are not movable at all:
+   their users hold kernel addresses directly.
+
+   Compaction runs with clock_list_lock and eviction_lock held. */
+
+#define COMPACT_PERIOD TIMER_FREQ
+#define COMPACT_PAGES (PTSPAN / PGSIZE)     /* Run kcompactd keeps free */
+
+bool compact_daemon;
+
+static unsigned long long run_cnt;          /* Compactions attempted */
+static unsigned long long success_cnt;      /* Compactions that freed a run */
+static unsigned long long migrate_cnt;      /* Frames moved */
+
+static void compact_thread(void *aux UNUSED);
+
+/* Starts the background compaction thread if -kcompactd was given. */
+void compact_init(void)
+{
+    if (compact_daemon)
+        thread_create("kcompactd", PRI_MIN, compact_thread, NULL);
+}
+
+/* Copies FRAME to the free user page KPAGE and points every mapping of
+   it there.  FRAME's old page stays allocated, now to the caller.
+   Only frames in the user pool move, so both pages are mapped.
+   Returns false, with nothing changed, if out of memory.
+
+   The owners may run while the frame table lock is held, so every
+   mapping is made not present before the copy; a write to the old
+   page after it was copied would be lost.  Clearing a mapping keeps
+   its writable, dirty and accessed bits, which the new mapping takes
+   over. */
+static bool frame_migrate(struct frame *frame, void *kpage)
+{
+    struct bitmap *cleared = bitmap_create(list_size(&frame->map_list));
+    struct list_elem *elem;
+    size_t i;
+
+    ASSERT(!highmem_contains(frame->paddr) && !highmem_contains(kpage));
+    if (cleared == NULL)
+        return false;
+
+    i = 0;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem), i++) {
+        struct frame_map *map = list_entry(elem, struct frame_map, elem);
+        void *vaddr = pg_round_down(map->spte->vaddr);
+
+        if (pagedir_get_page(map->pagedir, vaddr) == NULL)
+            continue;
+        pagedir_clear_page(map->pagedir, vaddr);
+        bitmap_mark(cleared, i);
+    }
+
+    memcpy(kpage, frame->paddr, PGSIZE);
+
+    i = 0;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem), i++) {
+        struct frame_map *map = list_entry(elem, struct frame_map, elem);
+        void *vaddr = pg_round_down(map->spte->vaddr);
+
+        if (!bitmap_test(cleared, i))
+            continue;
+        bool writable = pagedir_is_writable(map->pagedir, vaddr);
+        bool dirty = pagedir_is_dirty(map->pagedir, vaddr);
+        bool accessed = pagedir_is_accessed(map->pagedir, vaddr);
+
+        /* The page table already exists, so this cannot fail. */
+        pagedir_set_page(map->pagedir, vaddr, kpage, writable);
+        pagedir_set_dirty(map->pagedir, vaddr, dirty);
+        pagedir_set_accessed(map->pagedir, vaddr, accessed);
+    }
+    bitmap_destroy(cleared);
+    frame->paddr = kpage;
+    migrate_cnt++;
+    return true;
+}
+
+/* Returns the run of PAGE_CNT user pages, starting at a multiple of
+   ALIGN pages, that takes the fewest moves to empty, or a null pointer
+   if every run holds a page that cannot move or the rest of the pool
+   has no room for the moved frames. */
+static uint8_t *pick_window(size_t page_cnt, size_t align)
+{
+    size_t pool_cnt;
+    uint8_t *pool = palloc_pool_base(PAL_USER, &pool_cnt);
+    size_t first = (align - pg_no(pool) % align) % align;
+    size_t stride = ROUND_UP(page_cnt, align);
+    size_t win_cnt, i;
+
+    if (first + page_cnt > pool_cnt)
+        return NULL;
+    win_cnt = (pool_cnt - first - page_cnt) / stride + 1;
+    size_t *movable = calloc(win_cnt, sizeof *movable);
+    if (movable == NULL)
+        return NULL;
+
+    /* One pass over the frame table counts the movable frames of every
+       run at once. */
+    struct list_elem *elem;
+    for (elem = list_begin(&clock_list); elem != list_end(&clock_list); elem = list_next(elem)) {
+        struct frame *frame = list_entry(elem, struct frame, clock_elem);
+        uint8_t *page = frame->paddr;
+
+        if (frame->pin_cnt > 0 || page < pool + first * PGSIZE || page >= pool + pool_cnt * PGSIZE)
+            continue;
+        size_t idx = (page - pool) / PGSIZE - first;
+        if (idx / stride < win_cnt && idx % stride < page_cnt)
+            movable[idx / stride]++;
+    }
+
+    size_t free_cnt = palloc_free_cnt(PAL_USER);
+    size_t best_moves = SIZE_MAX;
+    uint8_t *best = NULL;
+    for (i = 0; i < win_cnt; i++) {
+        uint8_t *win = pool + (first + i * stride) * PGSIZE;
+        size_t win_free = palloc_free_in(win, page_cnt);
+        size_t moves = page_cnt - win_free;
+
+        if (win_free + movable[i] == page_cnt && moves < best_moves
+            && moves <= free_cnt - win_free) {
+            best = win;
+            best_moves = moves;
+        }
+    }
+    free(movable);
+    return best;
+}
+
+/* Empties the PAGE_CNT pages at WIN by moving their frames elsewhere,
+   and allocates them.  Returns false, with none of them allocated, if
+   some page could not be had. */
+static bool empty_window(uint8_t *win, size_t page_cnt)
+{
+    struct bitmap *held = bitmap_create(page_cnt);
+    struct list_elem *elem;
+    size_t i;
+
+    if (held == NULL)
+        return false;
+
+    /* Take the free pages first, so no frame is moved into the run. */
+    for (i = 0; i < page_cnt; i++)
+        if (palloc_claim(win + i * PGSIZE))
+            bitmap_mark(held, i);
+
+    for (elem = list_begin(&clock_list); elem != list_end(&clock_list); elem = list_next(elem)) {
+        struct frame *frame = list_entry(elem, struct frame, clock_elem);
+        uint8_t *page = frame->paddr;
+
+        if (frame->pin_cnt > 0 || page < win || page >= win + page_cnt * PGSIZE)
+            continue;
+        void *kpage = palloc_get_page(PAL_USER);
+        if (kpage == NULL)
+            break;
+        if (!frame_migrate(frame, kpage)) {
+            palloc_free_page(kpage);
+            break;
+        }
+        bitmap_mark(held, (page - win) / PGSIZE);
+    }
+
+    bool emptied = bitmap_all(held, 0, page_cnt);
+    if (!emptied)
+        for (i = 0; i < page_cnt; i++)
+            if (bitmap_test(held, i))
+                palloc_free_page(win + i * PGSIZE);
+    bitmap_destroy(held);
+    return emptied;
+}
+
+/* Allocates PAGE_CNT contiguous user pages starting at a multiple of
+   ALIGN pages, like palloc_get_aligned(), compacting the user pool if
+   no such run is free.  Returns a null pointer if none can be made.
+   Must be called with clock_list_lock held. */
+void *compact_alloc(size_t page_cnt, size_t align)
+{
+    uint8_t *pages = palloc_get_aligned(PAL_USER, page_cnt, align);
+    if (pages != NULL)
+        return pages;
+
+    ASSERT(lock_held_by_current_thread(&clock_list_lock));
+    bool eviction_held = lock_held_by_current_thread(&eviction_lock);
+    if (!eviction_held)
+        lock_acquire(&eviction_lock);
+    run_cnt++;
+    pages = pick_window(page_cnt, align);
+    if (pages != NULL && !empty_window(pages, page_cnt))
+        pages = NULL;
+    if (pages != NULL)
+        success_cnt++;
+    if (!eviction_held)
+        lock_release(&eviction_lock);
+    return pages;
+}
+
+/* Keeps one large page's worth of user memory free and aligned while
+   there is memory to spare, so promotions need not compact. */
+static void compact_thread(void *aux UNUSED)
+{
+    for (;;)
+    {
+        timer_sleep(COMPACT_PERIOD);
+        if (!largepage_enabled || palloc_free_cnt(PAL_USER) < 2 * COMPACT_PAGES)
+            continue;
+
+        lock_acquire(&clock_list_lock);
+        void *pages = compact_alloc(COMPACT_PAGES, COMPACT_PAGES);
+        lock_release(&clock_list_lock);
+        if (pages != NULL)
+            palloc_free_multiple(pages, COMPACT_PAGES);
+    }
+}
+
+void compact_print_stats(void)
+{
+    printf("Compaction: %llu runs, %llu succeeded, %llu frames migrated\n",
+           run_cnt, success_cnt, migrate_cnt);
+}
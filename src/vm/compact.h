@@ -0,0 +1,15 @@
+#ifndef VM_COMPACT_H
+#define VM_COMPACT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Whether a background thread keeps a large page's worth of user
+   memory free and aligned.  Set by -kcompactd. */
+extern bool compact_daemon;
+
+void compact_init(void);
+void *compact_alloc(size_t page_cnt, size_t align);
+void compact_print_stats(void);
+
+#endif
@@ -1,9 +1,23 @@
 #include "frame.h"
+#include "threads/highmem.h"
 #include "threads/malloc.h"
+#include "threads/shrinker.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
 #include "lib/kernel/bitmap.h"
 #include "userprog/process.h"
+#include "vm/compact.h"
+#include "vm/ksm.h"
+#include "vm/largepage.h"
+#include "vm/reclaim.h"
+#include "vm/rss.h"
+#include "vm/vmstat.h"
+#include "vm/writeback.h"
+#include <stdio.h>
+
+/* Shared zero page statistics. */
+static unsigned zero_map_cnt;   /* Reads served by the zero page */
+static unsigned zero_drop_cnt;  /* All-zero pages dropped instead of written */
 
 static struct list_elem* find_next_clock(void)
 {
@@ -17,6 +31,7 @@ static struct list_elem* find_next_clock(void)
 
     if (list_next(clock_elem) == list_end(&clock_list))
     {
+        vmstat_count(VM_CLOCK_WRAP);
         return list_begin(&clock_list);
     }
     else
@@ -31,13 +46,35 @@ void frame_table_init(void)
     list_init(&clock_list);
     lock_init(&eviction_lock);
     lock_init(&clock_list_lock);
+    cond_init(&frame_unpinned);
     clock_elem = NULL;
+    frame_cnt = 0;
+    evict_cnt = 0;
+    zero_page = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+    pcache_init();
+    vm_policy_init();
+    reclaim_init();
+    writeback_init();
+    rss_init();
+    ksm_init();
+    largepage_init();
+    compact_init();
+}
+
+/* Advances the clock hand and returns the frame under it.
+   The frame_table must not be empty. */
+struct frame *frame_clock_advance(void)
+{
+    clock_elem = find_next_clock();
+    return list_entry(clock_elem, struct frame, clock_elem);
 }
 
 /* Add frame to the frame_table. */
 void add_frame(struct frame *frame)
 {
     list_push_back(&clock_list, &(frame->clock_elem));
+    frame_cnt++;
+    vm_policy->on_insert(frame);
 }
 
 /* Delete frame from the frame_table. */
@@ -47,93 +84,617 @@ void delete_frame(struct frame *frame)
         clock_elem = list_next(clock_elem);
     }
     list_remove(&frame->clock_elem);
+    reclaim_forget(frame);
+    writeback_forget(frame);
+    ksm_forget(frame);
+    frame_cnt--;
+    vm_policy->on_remove(frame);
+}
+
+/* Searches the frame_table for the frame holding PADDR. */
+static struct frame *find_frame(void *paddr)
+{
+    struct list_elem *elem;
+    for (elem = list_begin(&clock_list); elem != list_end(&clock_list); elem = list_next(elem)) {
+        struct frame *frame = list_entry(elem, struct frame, clock_elem);
+        if (frame->paddr == paddr)
+            return frame;
+    }
+    return NULL;
+}
+
+/* Records in the reverse map that SPTE of thread T maps FRAME. */
+static bool frame_map_thread(struct frame *frame, struct spt_entry *spte, struct thread *t)
+{
+    struct frame_map *map = malloc(sizeof(struct frame_map));
+    if (map == NULL)
+        return false;
+
+    map->owner = t;
+    map->pagedir = t->pagedir;
+    map->spt = &t->spt;
+    map->spte = spte;
+    list_push_back(&frame->map_list, &map->elem);
+    map->owner->rss++;
+    spte->frame = frame;
+    if (frame->pce != NULL)
+        pcache_get(frame->pce);
+    vm_policy->on_access(frame, spte);
+    return true;
+}
+
+/* Records in the reverse map that SPTE of the current thread maps FRAME. */
+bool frame_map_page(struct frame *frame, struct spt_entry *spte)
+{
+    return frame_map_thread(frame, spte, thread_current());
+}
+
+/* Removes MAP from FRAME's reverse map and from its page directory. */
+void frame_unmap_page(struct frame *frame, struct frame_map *map)
+{
+    pagedir_clear_page(map->pagedir, pg_round_down(map->spte->vaddr));
+    map->spte->is_loaded = false;
+    map->spte->frame = NULL;
+    map->owner->rss--;
+    list_remove(&map->elem);
+    free(map);
+    if (frame->pce != NULL)
+        pcache_put(frame->pce);
+}
+
+/* Returns the spte of one of the pages mapping FRAME, or NULL if it is unmapped.
+   All mappings of a frame hold the same contents, so any of them describes it. */
+struct spt_entry *frame_spte(struct frame *frame)
+{
+    if (list_empty(&frame->map_list))
+        return NULL;
+    return list_entry(list_front(&frame->map_list), struct frame_map, elem)->spte;
+}
+
+/* Checks whether any mapping of FRAME has been accessed. */
+bool frame_is_accessed(struct frame *frame)
+{
+    struct list_elem *elem;
+    if (frame->referenced)
+        return true;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+        struct frame_map *map = list_entry(elem, struct frame_map, elem);
+        if (pagedir_is_accessed(map->pagedir, map->spte->vaddr))
+            return true;
+    }
+    return false;
+}
+
+/* Clears the accessed bit of every mapping of FRAME. */
+void frame_clear_accessed(struct frame *frame)
+{
+    struct list_elem *elem;
+    frame->referenced = false;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+        struct frame_map *map = list_entry(elem, struct frame_map, elem);
+        pagedir_set_accessed(map->pagedir, map->spte->vaddr, false);
+    }
+}
+
+/* Checks whether any mapping of FRAME has been written to. */
+bool frame_is_dirty(struct frame *frame)
+{
+    struct list_elem *elem;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+        struct frame_map *map = list_entry(elem, struct frame_map, elem);
+        if (pagedir_is_dirty(map->pagedir, map->spte->vaddr))
+            return true;
+    }
+    return false;
+}
+
+/* Clears the dirty bit of every mapping of FRAME. */
+static void frame_clear_dirty(struct frame *frame)
+{
+    struct list_elem *elem;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+        struct frame_map *map = list_entry(elem, struct frame_map, elem);
+        pagedir_set_dirty(map->pagedir, map->spte->vaddr, false);
+    }
+}
+
+/* Checks whether the page at KPAGE holds nothing but zeros. */
+bool page_is_zero(const void *kpage)
+{
+    const uint32_t *word = kmap(kpage);
+    bool zero = true;
+    size_t i;
+    for (i = 0; i < PGSIZE / sizeof *word && zero; i++)
+        zero = word[i] == 0;
+    kunmap((void *) word);
+    return zero;
+}
+
+/* Pins FRAME so that it is neither evicted nor moved while the kernel
+   accesses it through a user address.  Pins nest.  Must be called
+   with clock_list_lock held. */
+void frame_pin(struct frame *frame)
+{
+    frame->pin_cnt++;
+}
+
+/* Undoes one frame_pin() of FRAME.  Must be called with
+   clock_list_lock held. */
+void frame_unpin(struct frame *frame)
+{
+    ASSERT(frame->pin_cnt > 0);
+    if (--frame->pin_cnt == 0)
+        cond_broadcast(&frame_unpinned, &clock_list_lock);
+}
+
+/* Returns the first frame under the clock hand that is not pinned,
+   or NULL if every frame is. */
+static struct frame *frame_unpinned_victim(void)
+{
+    size_t i;
+    for (i = 0; i < frame_cnt; i++)
+    {
+        struct frame *frame = frame_clock_advance();
+        if (frame->pin_cnt == 0)
+            return frame;
+    }
+    return NULL;
 }
 
-/* When there's a shortage of physical frames, the clock algorithm is used to secure additional memory. */
+/* Turns every page mapping FRAME, which holds only zeros, into a zero
+   fill page, so that it can be dropped instead of written to swap. */
+static void frame_set_zero(struct frame *frame)
+{
+    struct list_elem *elem;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+        struct spt_entry *spte = list_entry(elem, struct frame_map, elem)->spte;
+        spte->type = ZERO;
+        spte->read_bytes = 0;
+        spte->zero_bytes = PGSIZE;
+    }
+    frame_clear_dirty(frame);
+    if (frame->swap_slot != BITMAP_ERROR) {
+        swap_drop(frame->swap_slot);
+        frame->swap_slot = BITMAP_ERROR;
+    }
+    zero_drop_cnt++;
+}
+
+/* Maps the shared zero page read-only at SPTE's address, for a read of
+   an untouched zero fill page. The first write gets a private frame. */
+bool frame_map_zero_page(struct spt_entry *spte)
+{
+    if (!pagedir_set_page(thread_current()->pagedir, spte->vaddr, zero_page, false))
+        return false;
+    spte->is_loaded = true;
+    zero_map_cnt++;
+    return true;
+}
+
+/* Writes dirty FRAME back without evicting it, so that it can later be
+   dropped without any I/O. File pages go back to their file, anything
+   else to a swap slot that the frame keeps. clock_list_lock is released
+   during the write, with FRAME pinned so that it stays put. Returns
+   false if the frame could not be cleaned. Must be called with
+   clock_list_lock held and eviction_lock not held. */
+bool frame_clean_unlocked(struct frame *frame)
+{
+    ASSERT(!lock_held_by_current_thread(&eviction_lock));
+    struct spt_entry *spte = frame_spte(frame);
+    if (spte == NULL)
+        return true;
+    /* A swap page that was read back in has no copy left in swap. */
+    if (!frame_is_dirty(frame) && (spte->type != SWAP || frame->swap_slot != BITMAP_ERROR))
+        return true;
+
+    if (spte->type != FILE && page_is_zero(frame->paddr))
+    {
+        frame_set_zero(frame);
+        return true;
+    }
+
+    /* Writes made while the page is being written set the dirty bit again. */
+    frame_clear_dirty(frame);
+    struct file *file = spte->type == FILE ? spte->file : NULL;
+    off_t offset = spte->offset;
+    size_t read_bytes = spte->read_bytes;
+    size_t slot = frame->swap_slot;
+
+    frame_pin(frame);
+    lock_release(&clock_list_lock);
+    if (file != NULL)
+    {
+        void *kaddr = kmap(frame->paddr);
+        file_write_at(file, kaddr, read_bytes, offset);
+        kunmap(kaddr);
+    }
+    else if (slot != BITMAP_ERROR)
+        swap_write(slot, frame->paddr);
+    else
+        slot = swap_out(frame->paddr);
+    lock_acquire(&clock_list_lock);
+    frame_unpin(frame);
+
+    if (file != NULL)
+        pcache_invalidate(file, offset, read_bytes);
+    else if (frame->swap_slot == BITMAP_ERROR)
+    {
+        if (slot == BITMAP_ERROR)
+        {
+            struct frame_map *map = list_entry(list_front(&frame->map_list), struct frame_map, elem);
+            pagedir_set_dirty(map->pagedir, map->spte->vaddr, true);
+            return false;
+        }
+        frame->swap_slot = slot;
+    }
+    return true;
+}
+
+/* Points every page mapping FRAME at swap slot SLOT, taking a slot
+   reference for each mapper so the page is written to swap only once. */
+static void frame_set_swap_slot(struct frame *frame, size_t slot)
+{
+    struct list_elem *elem;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+        struct spt_entry *spte = list_entry(elem, struct frame_map, elem)->spte;
+        if (elem != list_begin(&frame->map_list))
+            swap_dup(slot);
+        spte->swap_slot = slot;
+        spte->type = SWAP;
+    }
+}
+
+/* Checks whether FRAME could go to swap in the same cluster as a
+   victim: it is private, anonymous, unused and not already in swap. */
+static bool swap_cluster_eligible(struct frame *frame)
+{
+    struct spt_entry *spte = frame_spte(frame);
+    return list_size(&frame->map_list) == 1 && frame->pce == NULL && frame->pin_cnt == 0
+           && frame->swap_slot == BITMAP_ERROR && !frame_is_accessed(frame)
+           && (spte->type == SWAP || (spte->type == ZERO && frame_is_dirty(frame)))
+           && !page_is_zero(frame->paddr);
+}
+
+/* Fills CLUSTER with VICTIM followed by the frames holding the virtual
+   pages right after VICTIM's page in the same address space, as long as
+   they can go to swap with it. Returns the number of frames. */
+static size_t swap_cluster_collect(struct frame *victim, struct frame *cluster[])
+{
+    size_t cnt = 1;
+    cluster[0] = victim;
+    if (list_size(&victim->map_list) != 1)
+        return cnt;
+
+    struct frame_map *map = list_entry(list_front(&victim->map_list), struct frame_map, elem);
+    for (; cnt < SWAP_CLUSTER; cnt++) {
+        void *vaddr = (uint8_t *) map->spte->vaddr + cnt * PGSIZE;
+        if (!is_user_vaddr(vaddr))
+            break;
+        struct spt_entry *spte = spt_find(map->spt, vaddr);
+        if (spte == NULL || spte->frame == NULL || !swap_cluster_eligible(spte->frame))
+            break;
+        cluster[cnt] = spte->frame;
+    }
+    return cnt;
+}
+
+/* Unmaps FRAME from every page directory, frees the frame and then the
+   physical page itself. Must be called with clock_list_lock and eviction_lock held. */
+void free_frame_locked(struct frame *frame)
+{
+    void *paddr = frame->paddr;
+    struct pcache_entry *pce = frame->pce;
+
+    if (frame->swap_slot != BITMAP_ERROR)
+        swap_drop(frame->swap_slot);
+    free_frame_helper(frame);
+    if (pce != NULL)
+        pcache_remove(pce);
+    if (highmem_contains(paddr))
+        highmem_free_page(paddr);
+    else
+        palloc_free_page(paddr);
+}
+
+/* Frees FRAME, whose contents are safe elsewhere, counting the
+   eviction as EVENT. */
+static void evict_frame_finish(struct frame *frame, enum vm_event event)
+{
+    vmstat_evict(frame, event);
+
+    /* Remember when the pages were evicted, so policies can spot refaults. */
+    evict_cnt++;
+    struct list_elem *elem;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem))
+        list_entry(elem, struct frame_map, elem)->spte->evict_stamp = evict_cnt;
+
+    /* Every alias is unmapped, so no page table keeps the freed page. */
+    free_frame_locked(frame);
+}
+
+/* Writes VICTIM, an anonymous frame with no swap slot, to swap together
+   with the cold anonymous pages that follow it in its address space.
+   They get adjacent slots and go out in a single write, so that a later
+   fault on VICTIM's page reads them back in one go. Like
+   frame_clean_unlocked(), the frames are pinned and clock_list_lock is
+   released during the write, and each frame keeps its slot. Returns the
+   number of frames written, which are left in CLUSTER, or 0 if swap is
+   full. Must be called with clock_list_lock held and eviction_lock not
+   held. */
+static size_t swap_clean_cluster(struct frame *victim, struct frame *cluster[])
+{
+    void *pages[SWAP_CLUSTER];
+    size_t cnt = swap_cluster_collect(victim, cluster);
+    size_t written = cnt;
+    size_t slot = BITMAP_ERROR;
+    size_t i;
+
+    ASSERT(!lock_held_by_current_thread(&eviction_lock));
+
+    /* Writes made while the pages are being written set the dirty bit again. */
+    for (i = 0; i < cnt; i++) {
+        pages[i] = cluster[i]->paddr;
+        frame_clear_dirty(cluster[i]);
+        frame_pin(cluster[i]);
+    }
+    lock_release(&clock_list_lock);
+    if (cnt > 1)
+        slot = swap_out_cluster(pages, cnt);
+    if (slot == BITMAP_ERROR) {
+        written = 1;
+        slot = swap_out(pages[0]);
+    }
+    lock_acquire(&clock_list_lock);
+
+    if (slot == BITMAP_ERROR)
+        written = 0;
+    for (i = 0; i < cnt; i++) {
+        frame_unpin(cluster[i]);
+        if (i < written)
+            cluster[i]->swap_slot = slot + i;
+        else {
+            struct frame_map *map = list_entry(list_front(&cluster[i]->map_list), struct frame_map, elem);
+            pagedir_set_dirty(map->pagedir, map->spte->vaddr, true);
+        }
+    }
+    return written;
+}
+
+/* Checks whether evicting FRAME means writing it out first. */
+static bool evict_needs_write(struct frame *frame)
+{
+    struct spt_entry *spte = frame_spte(frame);
+    bool dirty = frame_is_dirty(frame);
+
+    if (spte == NULL)
+        return false;
+    if (frame->swap_slot != BITMAP_ERROR || spte->type == FILE)
+        return dirty;
+    if (spte->type == ZERO && !dirty)
+        return false;
+    return !page_is_zero(frame->paddr);
+}
+
+static void evict_victim(struct frame *victim);
+
+/* When there's a shortage of physical frames, the clock algorithm is used to secure additional memory.
+   Must be called with clock_list_lock held. If every frame is pinned, waits
+   for one to be unpinned and returns without evicting, so callers retry. */
 void evict_frames(void)
 {
     lock_acquire(&eviction_lock);
     struct frame *frame;
     struct frame *frame_to_be_evicted;
 
-    clock_elem=find_next_clock();
-
-    frame = list_entry(clock_elem, struct frame, clock_elem);
+    /* Unmapped page cache pages are clean and belong to nobody,
+       so give them up before touching any working set. */
+    frame = pcache_idle_frame();
+    if (frame != NULL)
+    {
+        vmstat_count(VM_EVICT_CLEAN);
+        free_frame_locked(frame);
+        lock_release(&eviction_lock);
+        return;
+    }
 
-    while(pagedir_is_accessed(frame->thread->pagedir, frame->spte->vaddr))
+    /* So are pages read ahead from swap, and other caches. */
+    if (shrink_caches(PAL_USER, 1) > 0)
     {
-        pagedir_set_accessed(frame->thread->pagedir, frame->spte->vaddr, false);
-        clock_elem = find_next_clock(); 
-        frame = list_entry(clock_elem, struct frame, clock_elem);
+        lock_release(&eviction_lock);
+        return;
     }
-    frame_to_be_evicted = frame;
 
-    /* Perform operations based on the type of spte. */
-    switch(frame_to_be_evicted->spte->type)
+    /* Large pages are split so that their pages age one by one. */
+    largepage_split_one();
+
+    /* Then frames the reclaim thread already cleaned, which cost no I/O,
+       then frames of processes over their resident limit. */
+    frame_to_be_evicted = reclaim_clean_victim();
+    if (frame_to_be_evicted == NULL)
+        frame_to_be_evicted = rss_select_victim();
+    if (frame_to_be_evicted == NULL)
+        frame_to_be_evicted = vm_policy->select_victim();
+    if (frame_to_be_evicted == NULL || frame_to_be_evicted->pin_cnt > 0)
+        frame_to_be_evicted = frame_unpinned_victim();
+
+    if (frame_to_be_evicted == NULL)
     {
-        case ZERO:
-            if(pagedir_is_dirty(frame_to_be_evicted->thread->pagedir, frame_to_be_evicted->spte->vaddr))
-            {
-                size_t swap_slot = swap_out(frame_to_be_evicted->paddr);
-                if (swap_slot == BITMAP_ERROR) {
-                    PANIC("Ran out of swap slots");
-                }
+        /* Every frame is pinned by a system call in progress; wait for
+           one to be unpinned instead of scanning again at once. */
+        lock_release(&eviction_lock);
+        cond_wait(&frame_unpinned, &clock_list_lock);
+        return;
+    }
+    evict_victim(frame_to_be_evicted);
+    lock_release(&eviction_lock);
+}
 
-                frame_to_be_evicted->spte->swap_slot = swap_slot;
-                frame_to_be_evicted->spte->type=SWAP;
-            }
-            break;
-        case FILE:
-            if(pagedir_is_dirty(frame_to_be_evicted->thread->pagedir, frame_to_be_evicted->spte->vaddr))
-                file_write_at(frame_to_be_evicted->spte->file, frame_to_be_evicted->spte->vaddr, frame_to_be_evicted->spte->read_bytes, frame_to_be_evicted->spte->offset);
-            break;
-        case SWAP:
-            frame_to_be_evicted->spte->swap_slot = swap_out(frame_to_be_evicted->paddr);
-            break;
+/* Evicts one of T's own frames to keep T under its hard resident
+   limit. Returns false if T has no frame to itself. */
+bool frame_evict_owned(struct thread *t)
+{
+    lock_acquire(&eviction_lock);
+    struct frame *frame = frame_select_owned(t);
+    if (frame != NULL)
+        evict_victim(frame);
+    lock_release(&eviction_lock);
+    return frame != NULL;
+}
+
+/* Picks a frame that only T maps, giving accessed frames a second
+   chance. Returns NULL if T has no frame to itself. */
+struct frame *frame_select_owned(struct thread *t)
+{
+    struct frame *fallback = NULL;
+    struct list_elem *elem;
+    for (elem = list_begin(&clock_list); elem != list_end(&clock_list); elem = list_next(elem)) {
+        struct frame *frame = list_entry(elem, struct frame, clock_elem);
+        if (list_size(&frame->map_list) != 1 || frame->pce != NULL || frame->pin_cnt > 0
+            || list_entry(list_front(&frame->map_list), struct frame_map, elem)->owner != t)
+            continue;
+        if (!frame_is_accessed(frame))
+            return frame;
+        frame_clear_accessed(frame);
+        if (fallback == NULL)
+            fallback = frame;
+    }
+    return fallback;
+}
+
+/* Frees FRAME, which needs no writing back, counting the eviction as
+   EVENT. Must be called with clock_list_lock and eviction_lock held. */
+static void evict_frame(struct frame *frame, enum vm_event event)
+{
+    struct spt_entry *spte = frame_spte(frame);
+
+    if (spte != NULL && frame->swap_slot != BITMAP_ERROR)
+    {
+        /* The frame was cleaned to swap; its pages now live in the slot. */
+        frame_set_swap_slot(frame, frame->swap_slot);
+        frame->swap_slot = BITMAP_ERROR;
     }
-    
-    frame_to_be_evicted->spte->is_loaded=false;
+    else if (spte != NULL && (spte->type == SWAP || (spte->type == ZERO && frame_is_dirty(frame))))
+    {
+        /* Nothing to save: the page comes back as a zero fill page. */
+        frame_set_zero(frame);
+    }
+    evict_frame_finish(frame, event);
+}
 
-    free_frame(frame_to_be_evicted->paddr);
+/* Evicts VICTIM, writing it back first if needed. The write is made
+   with both locks released, so that faults and other evictions go on
+   meanwhile; the frames written are pinned, and afterwards evicted
+   unless they were used in the meantime, in which case they stay as
+   clean frames that can be dropped later without I/O. An anonymous
+   victim goes to swap with the cold pages that follow it, which are
+   evicted too. Must be called with clock_list_lock and eviction_lock
+   held. */
+static void evict_victim(struct frame *victim)
+{
+    struct frame *cluster[SWAP_CLUSTER];
+    struct spt_entry *spte = frame_spte(victim);
+    enum vm_event event;
+    size_t cnt = 1;
+    size_t i;
+
+    if (!evict_needs_write(victim))
+    {
+        evict_frame(victim, VM_EVICT_CLEAN);
+        return;
+    }
 
+    cluster[0] = victim;
     lock_release(&eviction_lock);
+    if (spte->type == FILE)
+    {
+        frame_clean_unlocked(victim);
+        event = VM_EVICT_FILE;
+    }
+    else
+    {
+        if (victim->swap_slot == BITMAP_ERROR)
+            cnt = swap_clean_cluster(victim, cluster);
+        else if (!frame_clean_unlocked(victim))
+            cnt = 0;
+        if (cnt == 0)
+            PANIC("Ran out of swap slots");
+        event = VM_EVICT_SWAP;
+    }
+    lock_acquire(&eviction_lock);
+
+    for (i = 0; i < cnt; i++)
+    {
+        struct frame *frame = cluster[i];
+        if (frame->pin_cnt == 0 && !frame_is_dirty(frame) && !frame_is_accessed(frame))
+            evict_frame(frame, event);
+    }
 }
 
 
-/* Creates a frame with the given spte with the physical address of 
-   a frame that loaded the same file. This spte doesn't have to be loaded, but has to be installed*/
+/* Adds a mapping for the given spte to the frame of the cached page holding
+   the same (inode, offset). This spte doesn't have to be loaded, but has to be installed*/
 struct frame *share_existing_page(struct spt_entry *spte) 
 {
-    if(spte->writable || spte->type != FILE){
+    if (!pcache_is_cacheable(spte))
         return NULL;
-    }
 
-    /* Iterate through the clock_list to find a frame loaded with the same file */
-    struct list_elem *elem = list_begin(&clock_list);
-    while (elem != list_end(&clock_list)) {
-        struct frame* pg = list_entry(elem, struct frame, clock_elem);
-        if (pg->spte->is_loaded && file_compare(pg->spte->file, spte->file)) {
-            /* This frame loaded the same file, so it can be shared. 
-               Setup the share_frame, which has the paddr of the loaded frame
-               and spte of the argument */
-            struct frame *share_frame = malloc(sizeof(struct frame));
-            if(share_frame == NULL) // Failed malloc
-                return NULL;
-            share_frame->paddr = pg->paddr;
-            share_frame->spte = spte;
-            share_frame->thread = thread_current();
-            /* Add this shared frame into the clock_list */
-            add_frame(share_frame);
-
-            lock_release(&clock_list_lock);
-            return share_frame;
-        }
+    struct pcache_entry *pce = pcache_lookup(spte);
+    if (pce == NULL)
+        return NULL;
 
-        elem = list_next(elem);
-    }
+    if (!frame_map_page(pce->frame, spte)) // Failed malloc
+        return NULL;
+    return pce->frame;
+}
 
-    /* Return false if not found */
-    return NULL;
+/* Sets up a frame for the user page KPAGE and adds it to the frame table. */
+static struct frame *frame_create(void *kpage)
+{
+    /* Initialize the struct frame. */
+    struct frame *frame = malloc(sizeof(struct frame));
+    frame->paddr = kpage;
+    list_init(&frame->map_list);
+    frame->pce = NULL;
+    frame->swap_slot = BITMAP_ERROR;
+    frame->last_used = 0;
+    frame->policy_bits = 0;
+    frame->clean_listed = false;
+    frame->dirty_since = 0;
+    frame->wb_queued = false;
+    frame->referenced = false;
+    frame->pin_cnt = 0;
+    frame->checksum = 0;
+    frame->ksm_merged = false;
+    frame->ksm_listed = false;
+
+    /* Insert the frame to the frame_table using add_frame(). */
+    add_frame(frame);
+    return frame;
+}
+
+/* Puts the user page KPAGE, already mapped at SPTE's address in T's
+   page directory, under the frame table. Must be called with
+   clock_list_lock held. */
+struct frame *frame_adopt(void *kpage, struct thread *t, struct spt_entry *spte)
+{
+    struct frame *frame = frame_create(kpage);
+    frame_map_thread(frame, spte, t);
+    return frame;
+}
+
+/* Returns a free page for a frame, or NULL if memory is exhausted.
+   User frames are the only pages high memory can hold, so they come
+   from there first, leaving the user pool to what needs it mapped. */
+static void *frame_get_page(enum palloc_flags flags)
+{
+    void *kpage = flags & PAL_USER ? highmem_get_page(flags) : NULL;
+    return kpage != NULL ? kpage : palloc_get_page(flags);
+}
+
+/* Returns the number of pages free for user frames. */
+size_t frame_free_cnt(void)
+{
+    return palloc_free_cnt(PAL_USER) + highmem_free_cnt();
 }
 
 /* Allocate frame. */
@@ -145,21 +706,19 @@ struct frame *allocate_frame(enum palloc_flags alloc_flag)
         lock_acquire(&clock_list_lock);
     }
         
-    /* Allocate frame using palloc_get_page(). */
-    uint8_t *kpage = palloc_get_page(alloc_flag);
+    /* A process at its hard resident limit replaces one of its own pages. */
+    rss_enforce_hard_limit();
+
+    uint8_t *kpage = frame_get_page(alloc_flag);
+    bool stalled = kpage == NULL;
     while (kpage == NULL)
     {
         evict_frames();
-        kpage = palloc_get_page(alloc_flag);
+        kpage = frame_get_page(alloc_flag);
     }
+    reclaim_note_alloc(stalled);
 
-    /* Initialize the struct frame. */
-    struct frame *frame = malloc(sizeof(struct frame));
-    frame->paddr = kpage;
-    frame->thread = thread_current();
-
-    /* Insert the frame to the frame_table using add_frame(). */
-    add_frame(frame);
+    struct frame *frame = frame_create(kpage);
 
     if (!wait_for_load)
         lock_release(&clock_list_lock);
@@ -170,32 +729,97 @@ struct frame *allocate_frame(enum palloc_flags alloc_flag)
 /* By traversing the frame_table, free the frame with corresponding paddr. */
 void free_frame(void *paddr)
 {
-    lock_acquire(&clock_list_lock); 
+    bool clock_list_held = lock_held_by_current_thread(&clock_list_lock);
+    if (!clock_list_held)
+        lock_acquire(&clock_list_lock); 
     if (!lock_held_by_current_thread(&eviction_lock))
         lock_acquire(&eviction_lock);
 
-    /* Search for the struct page corresponding to the physicall address paddr in the clock_list. */
-    struct list_elem *elem = list_begin(&clock_list);
-    while (elem != list_end(&clock_list)) {
-        struct frame* free_frame = list_entry(elem, struct frame, clock_elem);
-        struct list_elem *elem2 = list_next(elem);
-        if (free_frame->paddr == paddr) {
-            free_frame_helper(free_frame);
+    struct frame *frame = find_frame(paddr);
+    if (frame != NULL)
+        free_frame_locked(frame);
+
+    lock_release(&eviction_lock);
+    if (!clock_list_held)
+        lock_release(&clock_list_lock);
+}
+
+/* Drops the current thread's mapping of PADDR. The page is freed once it
+   has no mappers left, except that a page cache page stays cached until
+   it is evicted. */
+void unmap_frame(void *paddr)
+{
+    bool clock_list_held = lock_held_by_current_thread(&clock_list_lock);
+    if (!clock_list_held)
+        lock_acquire(&clock_list_lock);
+    if (!lock_held_by_current_thread(&eviction_lock))
+        lock_acquire(&eviction_lock);
+
+    struct frame *frame = paddr != NULL ? find_frame(pg_round_down(paddr)) : NULL;
+    if (frame != NULL)
+    {
+        struct list_elem *elem;
+        for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+            struct frame_map *map = list_entry(elem, struct frame_map, elem);
+            if (map->pagedir == thread_current()->pagedir) {
+                frame_unmap_page(frame, map);
+                break;
+            }
         }
-        elem = elem2;
+
+        if (list_empty(&frame->map_list) && frame->pce == NULL)
+            free_frame_locked(frame);
     }
 
     lock_release(&eviction_lock);
-    lock_release(&clock_list_lock);
+    if (!clock_list_held)
+        lock_release(&clock_list_lock);
 }
 
-/* Helper function to be used in freeing frames. */
+/* Drops SPTE's mapping of FRAME for a process that is tearing down its
+   whole address space, freeing the frame if nobody else maps it.  The
+   page table entry is left alone, to go with the page tables in
+   pagedir_destroy_tables(), so that no TLB flush is needed per page.
+   Must be called with clock_list_lock and eviction_lock held. */
+void frame_release_spte(struct frame *frame, struct spt_entry *spte)
+{
+    struct list_elem *elem;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+        struct frame_map *map = list_entry(elem, struct frame_map, elem);
+        if (map->spte == spte) {
+            spte->is_loaded = false;
+            spte->frame = NULL;
+            map->owner->rss--;
+            list_remove(&map->elem);
+            free(map);
+            if (frame->pce != NULL)
+                pcache_put(frame->pce);
+            break;
+        }
+    }
+
+    if (list_empty(&frame->map_list) && frame->pce == NULL)
+        free_frame_locked(frame);
+}
+
+/* Helper function to be used in freeing frames. Unmaps every alias of the
+   frame; the physical page itself is freed by the caller. */
 void free_frame_helper (struct frame *frame)
 {
     /* Delete from frame_table. */
     delete_frame(frame);
+    /* Remove every mapping recorded in the reverse map. */
+    while (!list_empty(&frame->map_list))
+        frame_unmap_page(frame, list_entry(list_front(&frame->map_list), struct frame_map, elem));
     /* Free the memory allocated to the struct frame. */
-    pagedir_clear_page (frame->thread->pagedir, pg_round_down(frame->spte->vaddr));
-    palloc_free_page(frame->paddr);
     free(frame);
 }
+
+/* Prints page replacement statistics. */
+void frame_print_stats(void)
+{
+    printf("VM: %s policy, %u evictions, %zu frames in use\n",
+           vm_policy->name, evict_cnt, frame_cnt);
+    printf("VM: %u zero page mappings, %u zero pages dropped\n",
+           zero_map_cnt, zero_drop_cnt);
+}
@@ -7,27 +7,78 @@
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "devices/swap.h"
+#include "vm/pcache.h"
+#include "vm/policy.h"
+
+/* One virtual mapping of a frame, used as a reverse map entry. */
+struct frame_map {
+  struct thread *owner;         /* Process holding the mapping */
+  uint32_t *pagedir;            /* Page directory holding the mapping */
+  struct spt *spt;              /* Supplemental page table holding spte */
+  struct spt_entry *spte;       /* Supplemental page table entry */
+  struct list_elem elem;        /* Allows insertion into frame's map_list */
+};
 
 struct frame {
   void *paddr;                  /* Physical address */
-  struct spt_entry *spte;       /* Supplemental page table entry */
-  struct thread *thread;        /* Owning thread */
+  struct list map_list;         /* Every (pagedir, vaddr) mapping the frame */
+  struct pcache_entry *pce;     /* Page cache entry if the page is shared */
+  size_t swap_slot;             /* Swap slot holding a clean copy, or BITMAP_ERROR */
+  int64_t last_used;            /* Tick the frame was last seen accessed */
+  unsigned policy_bits;         /* Replacement policy state */
+  struct list_elem policy_elem; /* Allows insertion into the policy's queues */
+  bool referenced;              /* Accessed bit taken over by the working set sampler */
+  unsigned pin_cnt;             /* Kernel accesses in progress; evicted only at 0 */
+  unsigned checksum;            /* Contents hash at the last merge scan */
+  bool ksm_merged;              /* Whether pages were merged into the frame */
+  bool ksm_listed;              /* Whether the frame is in the merge table */
+  struct hash_elem ksm_elem;    /* Allows insertion into the merge table */
+  bool clean_listed;            /* Whether the frame is on the clean list */
+  struct list_elem clean_elem;  /* Allows insertion into the clean list */
+  int64_t dirty_since;          /* Tick the flusher first saw the frame dirty, or 0 */
+  bool wb_queued;               /* Whether the frame is queued for write-back */
+  struct list_elem wb_elem;     /* Allows insertion into the write-back queue */
   struct list_elem clock_elem;  /* Allows insertion into frame table */
 };
 
 struct lock clock_list_lock;
 struct lock eviction_lock;
+struct condition frame_unpinned; /* Signalled when a frame's last pin goes */
 struct list clock_list;
 struct list_elem *clock_elem;
+size_t frame_cnt;               /* Number of frames in the frame table */
+unsigned evict_cnt;             /* Number of frames evicted so far */
+void *zero_page;                /* Shared read-only page of zeros */
 
 void frame_table_init(void);
 void add_frame(struct frame* frame);
 void delete_frame(struct frame *frame);
 
+bool frame_map_page(struct frame *frame, struct spt_entry *spte);
+void frame_unmap_page(struct frame *frame, struct frame_map *map);
+struct spt_entry *frame_spte(struct frame *frame);
+bool frame_is_accessed(struct frame *frame);
+void frame_clear_accessed(struct frame *frame);
+bool frame_is_dirty(struct frame *frame);
+bool frame_clean_unlocked(struct frame *frame);
+struct frame *frame_clock_advance(void);
+bool frame_map_zero_page(struct spt_entry *spte);
+void frame_pin(struct frame *frame);
+void frame_unpin(struct frame *frame);
+bool page_is_zero(const void *kpage);
+
 void evict_frames(void);
-struct frame *share_existing_page(struct spt_entry *spte); 
+bool frame_evict_owned(struct thread *t);
+struct frame *frame_select_owned(struct thread *t);
+struct frame *share_existing_page(struct spt_entry *spte);
 struct frame *allocate_frame(enum palloc_flags alloc_flag);
+size_t frame_free_cnt(void);
+struct frame *frame_adopt(void *kpage, struct thread *t, struct spt_entry *spte);
 void free_frame(void *paddr);
+void free_frame_locked(struct frame *frame);
+void unmap_frame(void *paddr);
+void frame_release_spte(struct frame *frame, struct spt_entry *spte);
 void free_frame_helper(struct frame *frame);
+void frame_print_stats(void);
 
 #endif
@@ -0,0 +1,234 @@
+#include "vm/ksm.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/highmem.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+
+/* Same page merging.  The ksm thread walks the frame table with its
+   own hand, ksm_pages frames every KSM_PERIOD, looking for anonymous
+   frames whose contents did not change since the previous walk.  Such
+   stable frames go into a table keyed by their checksum; a stable frame
+   that matches one already in the table has its mappings moved over
+   and is freed.  Merged frames are mapped read-only, so the first
+   write to one takes the copy-on-write path like a forked page does.
+
+   The table is rebuilt on every walk, so frames written to in the
+   meantime drop out of it.  All state is protected by clock_list_lock;
+   mappings are moved with eviction_lock held as well. */
+
+#define KSM_PERIOD (TIMER_FREQ / 10)
+
+static struct hash merge_table;         /* Stable frames by checksum */
+static struct list_elem *ksm_hand;      /* Scanner's position in clock_list */
+
+static unsigned long long scan_cnt;     /* Frames scanned */
+static unsigned long long merge_cnt;    /* Frames freed by merging */
+
+static void ksm_thread(void *aux UNUSED);
+
+static unsigned frame_checksum_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+    return hash_int(hash_entry(e, struct frame, ksm_elem)->checksum);
+}
+
+static bool frame_checksum_less(const struct hash_elem *a, const struct hash_elem *b,
+                                void *aux UNUSED)
+{
+    return hash_entry(a, struct frame, ksm_elem)->checksum
+           < hash_entry(b, struct frame, ksm_elem)->checksum;
+}
+
+/* Starts the merge thread, unless merging is disabled. */
+void ksm_init(void)
+{
+    if (ksm_pages == 0)
+        return;
+    hash_init(&merge_table, frame_checksum_hash, frame_checksum_less, NULL);
+    ksm_hand = NULL;
+    thread_create("ksm", PRI_MIN, ksm_thread, NULL);
+}
+
+/* Forgets FRAME, which is leaving the frame table. */
+void ksm_forget(struct frame *frame)
+{
+    if (ksm_pages == 0)
+        return;
+    if (ksm_hand == &frame->clock_elem)
+        ksm_hand = list_next(ksm_hand);
+    if (frame->ksm_listed)
+    {
+        hash_delete(&merge_table, &frame->ksm_elem);
+        frame->ksm_listed = false;
+    }
+}
+
+static void unlist_frame(struct hash_elem *e, void *aux UNUSED)
+{
+    hash_entry(e, struct frame, ksm_elem)->ksm_listed = false;
+}
+
+/* Advances the scanner hand and returns the frame under it.  Starting
+   a new walk empties the merge table. */
+static struct frame *ksm_hand_advance(void)
+{
+    if (ksm_hand == NULL || ksm_hand == list_end(&clock_list)
+        || list_next(ksm_hand) == list_end(&clock_list))
+    {
+        hash_clear(&merge_table, unlist_frame);
+        ksm_hand = list_begin(&clock_list);
+    }
+    else
+        ksm_hand = list_next(ksm_hand);
+    return list_entry(ksm_hand, struct frame, clock_elem);
+}
+
+/* Checks whether FRAME holds anonymous memory that merging may share. */
+static bool ksm_eligible(struct frame *frame)
+{
+    struct spt_entry *spte = frame_spte(frame);
+    return spte != NULL && spte->type != FILE && frame->pce == NULL
+           && frame->pin_cnt == 0 && !page_is_zero(frame->paddr);
+}
+
+/* Maps every page of FRAME read-only, so its contents stay put. */
+static void frame_write_protect(struct frame *frame)
+{
+    struct list_elem *elem;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list); elem = list_next(elem)) {
+        struct frame_map *map = list_entry(elem, struct frame_map, elem);
+        pagedir_set_writable(map->pagedir, map->spte->vaddr, false);
+    }
+}
+
+/* Lets the single writable mapper of FRAME write to it again. */
+static void frame_write_unprotect(struct frame *frame)
+{
+    if (list_size(&frame->map_list) != 1)
+        return;
+    struct frame_map *map = list_entry(list_front(&frame->map_list), struct frame_map, elem);
+    if (map->spte->writable)
+        pagedir_set_writable(map->pagedir, map->spte->vaddr, true);
+}
+
+/* Checks whether A and B are written back the same way, so that
+   eviction, which goes by the first mapping of a frame, saves the
+   pages of both once they share a frame. */
+static bool ksm_same_writeback(struct frame *a, struct frame *b)
+{
+    return frame_spte(a)->type == frame_spte(b)->type;
+}
+
+/* Moves every mapping of FROM over to INTO, which holds the same
+   contents, and frees FROM.  Both are write protected. */
+static void ksm_merge(struct frame *from, struct frame *into)
+{
+    bool dirty = frame_is_dirty(from);
+    bool accessed = frame_is_accessed(from);
+
+    lock_acquire(&eviction_lock);
+    while (!list_empty(&from->map_list))
+    {
+        struct frame_map *map = list_entry(list_pop_front(&from->map_list), struct frame_map, elem);
+        void *vaddr = map->spte->vaddr;
+
+        pagedir_clear_page(map->pagedir, vaddr);
+        /* The page table already exists, so this cannot fail. */
+        pagedir_set_page(map->pagedir, vaddr, into->paddr, false);
+        pagedir_set_dirty(map->pagedir, vaddr, dirty);
+        pagedir_set_accessed(map->pagedir, vaddr, accessed);
+        map->spte->frame = into;
+        list_push_back(&into->map_list, &map->elem);
+    }
+    into->ksm_merged = true;
+    free_frame_locked(from);
+    lock_release(&eviction_lock);
+    merge_cnt++;
+}
+
+/* Scans FRAME: records its checksum, and once its contents are stable
+   merges it with an identical frame seen earlier in this walk. */
+static void ksm_scan_frame(struct frame *frame)
+{
+    scan_cnt++;
+    if (frame->ksm_listed || !ksm_eligible(frame))
+        return;
+
+    void *kaddr = kmap(frame->paddr);
+    unsigned checksum = hash_bytes(kaddr, PGSIZE);
+    kunmap(kaddr);
+    if (checksum != frame->checksum)
+    {
+        frame->checksum = checksum;
+        return;
+    }
+
+    struct hash_elem *e = hash_insert(&merge_table, &frame->ksm_elem);
+    if (e == NULL)
+    {
+        frame->ksm_listed = true;
+        return;
+    }
+
+    /* Compare under write protection, so neither frame changes before
+       the mappings move. */
+    struct frame *match = hash_entry(e, struct frame, ksm_elem);
+    if (match->pin_cnt > 0 || !ksm_same_writeback(frame, match))
+        return;
+    frame_write_protect(frame);
+    frame_write_protect(match);
+    void *a = kmap(frame->paddr), *b = kmap(match->paddr);
+    bool same = memcmp(a, b, PGSIZE) == 0;
+    kunmap(b);
+    kunmap(a);
+    if (same)
+        ksm_merge(frame, match);
+    else
+    {
+        frame_write_unprotect(frame);
+        frame_write_unprotect(match);
+    }
+}
+
+static void ksm_thread(void *aux UNUSED)
+{
+    for (;;)
+    {
+        timer_sleep(KSM_PERIOD);
+
+        lock_acquire(&clock_list_lock);
+        size_t i;
+        for (i = 0; i < ksm_pages && i < frame_cnt; i++)
+            ksm_scan_frame(ksm_hand_advance());
+        lock_release(&clock_list_lock);
+    }
+}
+
+/* Prints same page merging statistics.  Pages shared are merged frames
+   still mapped more than once; pages saved are their extra mappings. */
+void ksm_print_stats(void)
+{
+    if (ksm_pages == 0)
+        return;
+
+    size_t shared = 0, saved = 0;
+    struct list_elem *e;
+    for (e = list_begin(&clock_list); e != list_end(&clock_list); e = list_next(e))
+    {
+        struct frame *frame = list_entry(e, struct frame, clock_elem);
+        size_t cnt = list_size(&frame->map_list);
+        if (frame->ksm_merged && cnt > 1)
+        {
+            shared++;
+            saved += cnt - 1;
+        }
+    }
+    printf("KSM: %llu frames scanned, %llu merged, %zu pages shared, %zu pages saved\n",
+           scan_cnt, merge_cnt, shared, saved);
+}
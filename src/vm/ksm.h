@@ -0,0 +1,16 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+
+#include <stddef.h>
+
+struct frame;
+
+/* Frames the merge thread scans per period, 0 to disable merging.
+   Set by -ksm=. */
+size_t ksm_pages;
+
+void ksm_init(void);
+void ksm_forget(struct frame *frame);
+void ksm_print_stats(void);
+
+#endif
@@ -0,0 +1,204 @@
+#include "vm/largepage.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/highmem.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/compact.h"
+#include "vm/frame.h"
+
+/* Transparent large pages.  Once every page of a 4 MB aligned region
+   of anonymous memory is resident in a private, writable frame, the
+   region is copied into 4 MB of aligned physical memory and mapped
+   with a single page directory entry, so that it takes one TLB entry
+   instead of 1024.
+
+   The pages of a large page leave the frame table; their sptes stay
+   loaded with no frame, like pages mapped to the zero page.  Whenever
+   a single page of the region has to be handled on its own, when it
+   is unmapped, when the process forks, or when memory runs short, the
+   large page is split back into 1024 ordinary frames.
+
+   The list of large pages is protected by clock_list_lock. */
+
+#define LARGE_PAGES (PTSPAN / PGSIZE)   /* Pages in a large page */
+
+/* A region mapped with a large page. */
+struct large_page {
+  struct thread *owner;         /* Process mapping the region */
+  uint8_t *vaddr;               /* User address of the region */
+  uint8_t *kpage;               /* Kernel address of the memory */
+  uint32_t *pt;                 /* Page table the large page replaced */
+  struct list_elem elem;        /* Allows insertion into large_list */
+};
+
+bool largepage_enabled = true;
+
+static struct list large_list;
+
+static unsigned long long promote_cnt;      /* Regions promoted */
+static unsigned long long split_cnt;        /* Large pages split */
+static unsigned long long alloc_fail_cnt;   /* Promotions without aligned memory,
+                                               even after compaction */
+
+void largepage_init(void)
+{
+    list_init(&large_list);
+}
+
+/* Checks whether SPTE's page could be part of a large page of T. */
+static bool largepage_eligible(struct thread *t, struct spt_entry *spte)
+{
+    struct frame *frame = spte != NULL ? spte->frame : NULL;
+    return frame != NULL && spte->type != FILE && spte->writable
+           && frame->pce == NULL && frame->pin_cnt == 0 && list_size(&frame->map_list) == 1
+           && pagedir_is_writable(t->pagedir, spte->vaddr);
+}
+
+/* Promotes the 4 MB region around SPTE's page, which was just
+   faulted in, to a large page if every page of it can go.  Returns
+   true if the region is now a large page.  Must be called with
+   clock_list_lock held. */
+bool largepage_try_promote(struct spt_entry *spte)
+{
+    struct thread *cur = thread_current();
+    uint8_t *base = (uint8_t *) ((uintptr_t) spte->vaddr & PDMASK);
+    size_t i;
+
+    if (!largepage_enabled || !is_user_vaddr(base + PTSPAN - 1))
+        return false;
+
+    /* Most regions fail on one of their ends, so look there first. */
+    if (!largepage_eligible(cur, spt_find(&cur->spt, base))
+        || !largepage_eligible(cur, spt_find(&cur->spt, base + PTSPAN - PGSIZE)))
+        return false;
+    for (i = 1; i < LARGE_PAGES - 1; i++)
+        if (!largepage_eligible(cur, spt_find(&cur->spt, base + i * PGSIZE)))
+            return false;
+
+    /* Copying needs a second set of pages for a moment; don't push
+       anything out for it. */
+    if (palloc_free_cnt(PAL_USER) < 2 * LARGE_PAGES)
+        return false;
+    struct large_page *lp = malloc(sizeof *lp);
+    if (lp == NULL)
+        return false;
+    uint8_t *kpage = compact_alloc(LARGE_PAGES, LARGE_PAGES);
+    if (kpage == NULL)
+    {
+        alloc_fail_cnt++;
+        free(lp);
+        return false;
+    }
+
+    /* The copies have no backing store, so they start out dirty. */
+    lock_acquire(&eviction_lock);
+    for (i = 0; i < LARGE_PAGES; i++)
+    {
+        struct spt_entry *page = spt_find(&cur->spt, base + i * PGSIZE);
+        void *kaddr = kmap(page->frame->paddr);
+        memcpy(kpage + i * PGSIZE, kaddr, PGSIZE);
+        kunmap(kaddr);
+        free_frame_locked(page->frame);
+        page->is_loaded = true;
+    }
+    cur->rss += LARGE_PAGES;
+
+    lp->owner = cur;
+    lp->vaddr = base;
+    lp->kpage = kpage;
+    lp->pt = pagedir_set_large(cur->pagedir, base, kpage, true, true);
+    lock_release(&eviction_lock);
+    list_push_back(&large_list, &lp->elem);
+    promote_cnt++;
+    return true;
+}
+
+/* Splits LP back into ordinary frames. */
+static void largepage_split(struct large_page *lp)
+{
+    struct thread *t = lp->owner;
+    size_t i;
+
+    bool eviction_held = lock_held_by_current_thread(&eviction_lock);
+    if (!eviction_held)
+        lock_acquire(&eviction_lock);
+    pagedir_split_large(t->pagedir, lp->vaddr, lp->pt);
+    if (!eviction_held)
+        lock_release(&eviction_lock);
+    t->rss -= LARGE_PAGES;
+    for (i = 0; i < LARGE_PAGES; i++)
+    {
+        struct spt_entry *spte = spt_find(&t->spt, lp->vaddr + i * PGSIZE);
+        ASSERT(spte != NULL);
+        frame_adopt(lp->kpage + i * PGSIZE, t, spte);
+    }
+
+    list_remove(&lp->elem);
+    free(lp);
+    split_cnt++;
+}
+
+/* Splits the large page holding VADDR in T, if there is one, so
+   that its pages can be handled one by one. Must be called with
+   clock_list_lock held. */
+void largepage_split_at(struct thread *t, void *vaddr)
+{
+    if (t->pagedir == NULL || !pagedir_is_large(t->pagedir, vaddr))
+        return;
+
+    uint8_t *base = (uint8_t *) ((uintptr_t) vaddr & PDMASK);
+    struct list_elem *e;
+    for (e = list_begin(&large_list); e != list_end(&large_list); e = list_next(e))
+    {
+        struct large_page *lp = list_entry(e, struct large_page, elem);
+        if (lp->owner == t && lp->vaddr == base)
+        {
+            largepage_split(lp);
+            return;
+        }
+    }
+    NOT_REACHED();
+}
+
+/* Splits every large page of T. Must be called with clock_list_lock
+   held. */
+void largepage_split_all(struct thread *t)
+{
+    struct list_elem *e = list_begin(&large_list);
+    while (e != list_end(&large_list))
+    {
+        struct large_page *lp = list_entry(e, struct large_page, elem);
+        e = list_next(e);
+        if (lp->owner == t)
+            largepage_split(lp);
+    }
+}
+
+/* Splits the oldest large page, so that its pages can be evicted one
+   by one.  Returns false if there is none. Must be called with
+   clock_list_lock held. */
+bool largepage_split_one(void)
+{
+    if (list_empty(&large_list))
+        return false;
+    largepage_split(list_entry(list_front(&large_list), struct large_page, elem));
+    return true;
+}
+
+/* Prints large page statistics.  Every large page mapped saves the
+   TLB 1023 entries for the same memory. */
+void largepage_print_stats(void)
+{
+    printf("Large pages: %llu promoted, %llu split, %llu without aligned memory, "
+           "%zu mapped\n",
+           promote_cnt, split_cnt, alloc_fail_cnt, list_size(&large_list));
+}
@@ -0,0 +1,20 @@
+#ifndef VM_LARGEPAGE_H
+#define VM_LARGEPAGE_H
+
+#include <stdbool.h>
+
+struct spt_entry;
+struct thread;
+
+/* Whether fully populated regions are promoted, cleared by
+   -no-largepages. */
+extern bool largepage_enabled;
+
+void largepage_init(void);
+bool largepage_try_promote(struct spt_entry *spte);
+void largepage_split_at(struct thread *t, void *vaddr);
+void largepage_split_all(struct thread *t);
+bool largepage_split_one(void);
+void largepage_print_stats(void);
+
+#endif
@@ -1,8 +1,11 @@
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/largepage.h"
+#include "vm/vma.h"
 #include "lib/string.h"
 #include "filesys/file.h"
 #include "userprog/pagedir.h"
+#include "threads/highmem.h"
 #include "threads/malloc.h"
 
 /* Using the vaddr of spt_entry as an argument, 
@@ -21,10 +24,11 @@ static bool spt_less_func(const struct hash_elem *a, const struct hash_elem *b,
 	return spte_a->vaddr < spte_b->vaddr;
 }
 
-/* Initialize Hash Table using hash_init. */
-void spt_init(struct hash *spt)
+/* Initialize Hash Table using hash_init.  The lock was initialized
+   with the thread. */
+void spt_init(struct spt *spt)
 {
-	hash_init(spt, spt_hash_func, spt_less_func, NULL);
+	hash_init(&spt->table, spt_hash_func, spt_less_func, NULL);
 }
 
 void spte_initialize(struct spt_entry *spte, enum spt_page_type type, void *addr, 
@@ -38,45 +42,121 @@ void spte_initialize(struct spt_entry *spte, enum spt_page_type type, void *addr
     spte->offset = offset;
     spte->read_bytes = page_read_bytes;
     spte->zero_bytes = page_zero_bytes;
+    spte->frame = NULL;
+    spte->evict_stamp = 0;
+}
+
+/* Releases the frame or the swap slot holding SPTE's page. */
+static void spte_release(struct spt_entry *spte)
+{
+	lock_acquire(&clock_list_lock);
+	/* A cleaner may be writing the frame out with the lock dropped. */
+	while (spte->frame != NULL && spte->frame->pin_cnt > 0)
+		cond_wait(&frame_unpinned, &clock_list_lock);
+	largepage_split_at(thread_current(), spte->vaddr);
+	/* A swapped out page may share its slot with a forked process. */
+	if (spte->frame == NULL && spte->type == SWAP)
+		swap_drop(spte->swap_slot);
+
+	/* unmap_frame will acquire eviction_lock only if the thread is not holding it.
+	   unmap_frame will eventually release eviction_lock before its return */
+	lock_acquire(&eviction_lock);
+	void *kpage = pagedir_get_page (thread_current ()->pagedir, spte->vaddr);
+	if (kpage != NULL && kpage == zero_page)
+	{
+		/* The shared zero page must not be freed with the page directory. */
+		pagedir_clear_page (thread_current ()->pagedir, spte->vaddr);
+		spte->is_loaded = false;
+		lock_release(&eviction_lock);
+	}
+	else
+		unmap_frame(kpage);
+	lock_release(&clock_list_lock);
+}
+
+/* Throws SPTE's page away for madvise(MADV_DONTNEED), freeing its frame
+   and swap slot.  Changes to a shared file mapping are written back
+   first; other pages come back as they were first loaded, from their
+   file or as zeros. */
+void spte_discard(struct spt_entry *spte)
+{
+	if (spte->type == FILE)
+	{
+		lock_acquire(&clock_list_lock);
+		if (spte->frame != NULL && frame_is_dirty(spte->frame))
+			frame_clean_unlocked(spte->frame);
+		lock_release(&clock_list_lock);
+	}
+
+	spte_release(spte);
+	spte->is_loaded = false;
+	spte->evict_stamp = 0;
+	if (spte->type == FILE)
+		return;
+	if (spte->file == NULL || spte->read_bytes == 0)
+	{
+		spte->read_bytes = 0;
+		spte->zero_bytes = PGSIZE;
+	}
+	spte->type = ZERO;
 }
 
 /* Insert spt_entry using hash_insert() function. */
-bool insert_spte(struct hash *spt, struct spt_entry *spte)
+bool insert_spte(struct spt *spt, struct spt_entry *spte)
 {
-	struct hash_elem* elem = hash_insert (spt, &(spte->elem));
+	lock_acquire(&spt->lock);
+	struct hash_elem* elem = hash_insert (&spt->table, &(spte->elem));
+	lock_release(&spt->lock);
 	if(elem == NULL)
 		return true;
 	else
 		return false;
 }
 /* Delete spt_entry from Hash Table using hash_delete() function. */
-bool delete_spte(struct hash *spt, struct spt_entry *spte)
+bool delete_spte(struct spt *spt, struct spt_entry *spte)
 {
-	struct hash_elem *elem = hash_delete(spt, &(spte->elem));
+	lock_acquire(&spt->lock);
+	struct hash_elem *elem = hash_delete(&spt->table, &(spte->elem));
+	lock_release(&spt->lock);
 
 	if(elem == NULL)
 		return false;
 	else
 	{
-		/* free_page will acquire eviction_lock only if the thread is not holding it.
-		   free_page will eventually release eviction_lock before its return */
-		lock_acquire(&eviction_lock);
-		free_frame(pagedir_get_page (thread_current ()->pagedir, spte->vaddr));
+		spte_release(spte);
 		free(spte);
 		return true;
 	}
 }
 
-/* Search and return the spt_entry corresponding to the vaddr argument. */
+/* Search and return the spt_entry corresponding to the vaddr argument.
+   The spte of a page in one of the current thread's regions is made
+   the first time it is looked for. */
 struct spt_entry *find_spte(void *vaddr)
 {
 	struct thread *cur = thread_current();
+	struct spt_entry *spte = spt_find(&cur->spt, vaddr);
+	if (spte == NULL)
+	{
+		struct vma *vma = vma_find(&cur->vmas, vaddr);
+		if (vma != NULL)
+			spte = vma_fault_in(vma, vaddr);
+	}
+	return spte;
+}
+
+/* Search SPT, which may belong to another thread, for the spt_entry
+   corresponding to VADDR. */
+struct spt_entry *spt_find(struct spt *spt, void *vaddr)
+{
 	struct spt_entry spte;
 
 	/* Get vaddr's page number using pg_round_down() function. */
 	spte.vaddr = pg_round_down(vaddr);
 
-	struct hash_elem* elem= hash_find(&(cur->spt), &(spte.elem));
+	lock_acquire(&spt->lock);
+	struct hash_elem* elem= hash_find(&spt->table, &(spte.elem));
+	lock_release(&spt->lock);
 
 	if(elem != NULL)
 		return hash_entry(elem, struct spt_entry, elem);
@@ -87,16 +167,80 @@ struct spt_entry *find_spte(void *vaddr)
 /* A helper function to be used in spt_destroy() function. */
 static void spt_destroy_helper(struct hash_elem *elem, void *aux UNUSED)
 {
-	struct spt_entry *spte = hash_entry(elem, struct spt_entry, elem);
-	lock_acquire(&eviction_lock);
-	free_frame(pagedir_get_page (thread_current ()->pagedir, spte->vaddr));
-	free(spte);
+	free(hash_entry(elem, struct spt_entry, elem));
 }
 
-/* Remove spt_entries from the hash table using the hash_destroy() function. */
-void spt_destroy(struct hash *spt)
+/* Swap slots given back with each swap_drop_batch() call. */
+#define SLOT_BATCH 64
+
+/* Checks whether a frame of SPT is pinned. */
+static bool spt_has_pinned(struct spt *spt)
 {
-	hash_destroy(spt, spt_destroy_helper);
+	struct hash_iterator i;
+
+	hash_first(&i, &spt->table);
+	while (hash_next(&i))
+	{
+		struct spt_entry *spte = hash_entry(hash_cur(&i), struct spt_entry, elem);
+		if (spte->frame != NULL && spte->frame->pin_cnt > 0)
+			return true;
+	}
+	return false;
+}
+
+/* Releases every page of SPT, the current thread's, as it goes away
+   with its address space, then removes the spt_entries from the hash
+   table using the hash_destroy() function.  The pages are released in
+   one pass with the frame table locks held throughout: each frame is
+   found through its spte, page table entries are left for
+   pagedir_destroy_tables(), and swap slots go back in batches.  Only
+   the owner changes the table, so the iteration is safe without its
+   lock, which is taken last. */
+void spt_destroy(struct spt *spt)
+{
+	struct thread *cur = thread_current();
+	struct hash_iterator i;
+	size_t slots[SLOT_BATCH];
+	size_t slot_cnt = 0;
+
+	/* Kernel threads have no pages, and may exit before the frame
+	   table is set up. */
+	if (hash_empty(&spt->table))
+		goto done;
+
+	lock_acquire(&clock_list_lock);
+	largepage_split_all(cur);
+	/* A cleaner may be writing a frame out with the lock dropped.  No
+	   new one starts while the lock stays held after they are done. */
+	while (spt_has_pinned(spt))
+		cond_wait(&frame_unpinned, &clock_list_lock);
+
+	lock_acquire(&eviction_lock);
+	hash_first(&i, &spt->table);
+	while (hash_next(&i))
+	{
+		struct spt_entry *spte = hash_entry(hash_cur(&i), struct spt_entry, elem);
+		if (spte->frame != NULL)
+			frame_release_spte(spte->frame, spte);
+		/* A swapped out page may share its slot with a forked process. */
+		else if (spte->type == SWAP)
+		{
+			slots[slot_cnt++] = spte->swap_slot;
+			if (slot_cnt == SLOT_BATCH)
+			{
+				swap_drop_batch(slots, slot_cnt);
+				slot_cnt = 0;
+			}
+		}
+	}
+	swap_drop_batch(slots, slot_cnt);
+	lock_release(&eviction_lock);
+	lock_release(&clock_list_lock);
+
+done:
+	lock_acquire(&spt->lock);
+	hash_destroy(&spt->table, spt_destroy_helper);
+	lock_release(&spt->lock);
 }
 
 /* Loads pages existing on the disk into physical memory. */
@@ -105,13 +249,14 @@ bool load_file(void* paddr, struct spt_entry *spte)
 	ASSERT(paddr != NULL);
 	ASSERT(spte != NULL);
 	ASSERT(spte->type == ZERO || spte->type == FILE);
-	lock_acquire(&eviction_lock);
-	int a = file_read_at(spte->file, paddr, spte->read_bytes, spte->offset);
-	if (a != (int) spte->read_bytes)
-	{
-		return false;
-	}
-    memset (paddr + spte->read_bytes, 0, spte->zero_bytes);
-	lock_release(&eviction_lock);
-  	return true;
+	uint8_t *kaddr = kmap(paddr);
+	bool loaded = true;
+	/* Pages found to be all zeros may have no file left to read. */
+	if (spte->read_bytes > 0
+	    && file_read_at(spte->file, kaddr, spte->read_bytes, spte->offset) != (int) spte->read_bytes)
+		loaded = false;
+	else
+		memset (kaddr + spte->read_bytes, 0, spte->zero_bytes);
+	kunmap(kaddr);
+	return loaded;
 }
\ No newline at end of file
@@ -13,6 +13,13 @@ enum spt_page_type {
   SWAP /* Bits will be swapped in from storage.  */
 };
 
+/* Access pattern hints given with madvise(). */
+enum spt_advice {
+  ADVICE_NORMAL,     /* No hint. */
+  ADVICE_RANDOM,     /* Pages are used in random order; don't read ahead. */
+  ADVICE_SEQUENTIAL  /* Pages are used once in order; read ahead far. */
+};
+
 struct spt_entry{
   enum spt_page_type type; /* Holds location of page or if it is all zero */
   void *vaddr;  /* Virtual address of page */
@@ -28,27 +35,35 @@ struct spt_entry{
   size_t zero_bytes; /* Number of bytes to set to 0 after reading from file */
 
   size_t swap_slot; /* Holds swap slot number of evicted pages */
+  struct frame *frame; /* Frame holding the page while it is loaded */
+  unsigned evict_stamp; /* evict_cnt when the page was last evicted, 0 if never */
 
   struct hash_elem elem; /* Allows insertion into supplemental page table */
 };
 
+struct vma;
+
 struct mmap_entry {
   int mapid;  /* Identifies mmap_entry to remove upon call to sys_munmap() */
   struct file * file; /* File being mapped into memory */
   struct list_elem elem; /* Allows insertion into thread's mmap_list */
   struct list spte_list; /* Holds spt entries corresponding to this mmap */
+  struct readahead ra; /* Sequential access state of the mapping */
+  struct vma *vma; /* Region covering the mapping, or NULL if it is empty */
 };
 
 
-void spt_init(struct hash *spt);
+void spt_init(struct spt *spt);
 void spte_initialize(struct spt_entry *spte, enum spt_page_type type, void *addr,
                      struct file *file, bool writable, bool is_loaded, off_t offset,
                      size_t page_read_bytes, size_t page_zero_bytes);
-bool insert_spte(struct hash *spt, struct spt_entry *spte);
-bool delete_spte(struct hash *spt, struct spt_entry *spte);
+bool insert_spte(struct spt *spt, struct spt_entry *spte);
+bool delete_spte(struct spt *spt, struct spt_entry *spte);
+void spte_discard(struct spt_entry *spte);
 
 struct spt_entry *find_spte(void *vaddr);
-void spt_destroy(struct hash *spt);
+struct spt_entry *spt_find(struct spt *spt, void *vaddr);
+void spt_destroy(struct spt *spt);
 
 bool load_file(void *paddr, struct spt_entry *spte);
 
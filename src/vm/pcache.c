@@ -0,0 +1,191 @@
+#include "vm/pcache.h"
+#include <round.h>
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "filesys/file.h"
+#include "userprog/syscall.h"
+#include "vm/frame.h"
+
+/* Page cache of read-only file pages, keyed by (inode, offset).
+   All accesses are made with clock_list_lock held.  Writes to a
+   file drop its cached pages through pcache_invalidate(). */
+static struct hash pcache;
+
+/* Cached pages that no process maps any more.  They stay resident
+   so a later exec of the same program can reuse them, and are the
+   first pages given up when frames run short. */
+static struct list idle_list;
+
+/* Reopens FILE under filesys_lock, which the caller may hold already. */
+static struct file *pcache_file_reopen(struct file *file)
+{
+    bool filesys_held = lock_held_by_current_thread(&filesys_lock);
+    if (!filesys_held)
+        lock_acquire(&filesys_lock);
+    struct file *reopened = file_reopen(file);
+    if (!filesys_held)
+        lock_release(&filesys_lock);
+    return reopened;
+}
+
+/* Closes FILE under filesys_lock, which the caller may hold already. */
+static void pcache_file_close(struct file *file)
+{
+    bool filesys_held = lock_held_by_current_thread(&filesys_lock);
+    if (!filesys_held)
+        lock_acquire(&filesys_lock);
+    file_close(file);
+    if (!filesys_held)
+        lock_release(&filesys_lock);
+}
+
+/* Hashes the inode and offset of a page cache entry. */
+static unsigned pcache_hash_func(const struct hash_elem *elem, void *aux UNUSED)
+{
+    struct pcache_entry *pce = hash_entry(elem, struct pcache_entry, elem);
+    return file_hash(pce->file) ^ hash_int(pce->offset);
+}
+
+/* Orders page cache entries by inode, then by offset. */
+static bool pcache_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED)
+{
+    struct pcache_entry *pce_a = hash_entry(a, struct pcache_entry, elem);
+    struct pcache_entry *pce_b = hash_entry(b, struct pcache_entry, elem);
+    if (!file_compare(pce_a->file, pce_b->file))
+        return file_get_inode(pce_a->file) < file_get_inode(pce_b->file);
+    return pce_a->offset < pce_b->offset;
+}
+
+void pcache_init(void)
+{
+    hash_init(&pcache, pcache_hash_func, pcache_less_func, NULL);
+    list_init(&idle_list);
+}
+
+/* Only pages that can never be written are shared: read-only mmap
+   pages and the read-only segments of executables. */
+bool pcache_is_cacheable(struct spt_entry *spte)
+{
+    return !spte->writable && spte->file != NULL
+           && (spte->type == FILE || spte->type == ZERO);
+}
+
+/* Returns the cached page holding the contents SPTE describes,
+   or NULL if it is not in the cache. */
+struct pcache_entry *pcache_lookup(struct spt_entry *spte)
+{
+    struct pcache_entry key;
+    key.file = spte->file;
+    key.offset = spte->offset;
+
+    struct hash_elem *elem = hash_find(&pcache, &key.elem);
+    if (elem == NULL)
+        return NULL;
+
+    struct pcache_entry *pce = hash_entry(elem, struct pcache_entry, elem);
+    /* A trailing .bss page may start at the same offset as the data
+       before it, so the page contents must match as well. */
+    if (pce->read_bytes != spte->read_bytes)
+        return NULL;
+    return pce;
+}
+
+/* Publishes FRAME, freshly loaded for SPTE, with a single mapper.
+   Returns NULL if the page cannot be cached. */
+struct pcache_entry *pcache_insert(struct spt_entry *spte, struct frame *frame)
+{
+    struct pcache_entry *pce = malloc(sizeof(struct pcache_entry));
+    if (pce == NULL)
+        return NULL;
+
+    pce->file = pcache_file_reopen(spte->file);
+    if (pce->file == NULL)
+    {
+        free(pce);
+        return NULL;
+    }
+    pce->offset = spte->offset;
+    pce->read_bytes = spte->read_bytes;
+    pce->frame = frame;
+    pce->mappers = 1;
+    pce->hashed = true;
+
+    if (hash_insert(&pcache, &pce->elem) != NULL)
+    {
+        pcache_file_close(pce->file);
+        free(pce);
+        return NULL;
+    }
+    return pce;
+}
+
+/* Adds a mapper to PCE. */
+void pcache_get(struct pcache_entry *pce)
+{
+    if (pce->mappers++ == 0)
+        list_remove(&pce->idle_elem);
+}
+
+/* Drops a mapper from PCE.  The page stays cached until its frame
+   is evicted. */
+void pcache_put(struct pcache_entry *pce)
+{
+    ASSERT(pce->mappers > 0);
+    if (--pce->mappers == 0)
+        list_push_back(&idle_list, &pce->idle_elem);
+}
+
+/* Removes PCE from the cache.  The caller frees the frame itself. */
+void pcache_remove(struct pcache_entry *pce)
+{
+    if (pce->mappers == 0)
+        list_remove(&pce->idle_elem);
+    if (pce->hashed)
+        hash_delete(&pcache, &pce->elem);
+    pcache_file_close(pce->file);
+    free(pce);
+}
+
+/* Drops the cached pages of FILE's inode that overlap the SIZE bytes
+   at OFFSET, after they were written.  Idle pages are freed; pages
+   still mapped are only unhashed, so their mappers keep the contents
+   they loaded but later mappings read the file again.  Must be called
+   with clock_list_lock held. */
+void pcache_invalidate(struct file *file, off_t offset, off_t size)
+{
+    if (size <= 0 || hash_empty(&pcache))
+        return;
+
+    bool eviction_held = lock_held_by_current_thread(&eviction_lock);
+    if (!eviction_held)
+        lock_acquire(&eviction_lock);
+
+    struct pcache_entry key;
+    key.file = file;
+    off_t end = offset + size;
+    for (key.offset = ROUND_DOWN(offset, PGSIZE); key.offset < end; key.offset += PGSIZE)
+    {
+        struct hash_elem *elem = hash_delete(&pcache, &key.elem);
+        if (elem == NULL)
+            continue;
+
+        struct pcache_entry *pce = hash_entry(elem, struct pcache_entry, elem);
+        pce->hashed = false;
+        if (pce->mappers == 0 && pce->frame->pin_cnt == 0)
+            free_frame_locked(pce->frame);
+    }
+
+    if (!eviction_held)
+        lock_release(&eviction_lock);
+}
+
+/* Returns the frame of the oldest unmapped cached page,
+   or NULL if there is no such page. */
+struct frame *pcache_idle_frame(void)
+{
+    if (list_empty(&idle_list))
+        return NULL;
+
+    struct pcache_entry *pce = list_entry(list_front(&idle_list), struct pcache_entry, idle_elem);
+    return pce->frame;
+}
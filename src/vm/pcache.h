@@ -0,0 +1,34 @@
+#ifndef VM_PCACHE_H
+#define VM_PCACHE_H
+
+#include <hash.h>
+#include <list.h>
+#include "vm/page.h"
+#include "filesys/off_t.h"
+
+struct frame;
+
+/* A read-only file page kept in memory so that every process mapping
+   the same (inode, offset) shares a single physical frame. */
+struct pcache_entry {
+  struct file *file;            /* Private handle keeping the inode open */
+  off_t offset;                 /* Page-aligned offset within the file */
+  size_t read_bytes;            /* Bytes of the page read from the file */
+  struct frame *frame;          /* Frame holding the cached page */
+  int mappers;                  /* Number of mappings of the page */
+  bool hashed;                  /* Whether new mappings may still share it */
+  struct hash_elem elem;        /* Allows insertion into the page cache */
+  struct list_elem idle_elem;   /* Allows insertion into the idle list */
+};
+
+void pcache_init(void);
+bool pcache_is_cacheable(struct spt_entry *spte);
+struct pcache_entry *pcache_lookup(struct spt_entry *spte);
+struct pcache_entry *pcache_insert(struct spt_entry *spte, struct frame *frame);
+void pcache_get(struct pcache_entry *pce);
+void pcache_put(struct pcache_entry *pce);
+void pcache_remove(struct pcache_entry *pce);
+void pcache_invalidate(struct file *file, off_t offset, off_t size);
+struct frame *pcache_idle_frame(void);
+
+#endif
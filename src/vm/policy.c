@@ -0,0 +1,237 @@
+#include "vm/policy.h"
+#include <string.h>
+#include "vm/frame.h"
+#include "devices/timer.h"
+#include "userprog/pagedir.h"
+
+/* Page replacement policies.  The frame table (clock_list) holds
+   every user frame in insertion order; the clock based policies sweep
+   it with the shared clock hand, while 2Q keeps its own queues. */
+
+/* Ticks a frame stays in the working set after its last access. */
+#define WSCLOCK_TAU (TIMER_FREQ / 2)
+
+/* Policy bits of CLOCK-Pro. */
+#define CP_HOT 0x1              /* Frame is hot */
+#define CP_TEST 0x2             /* Cold frame is in its test period */
+
+/* Policy bits of 2Q. */
+#define Q_A1 0x1                /* Frame is on the A1 FIFO */
+#define Q_AM 0x2                /* Frame is on the Am queue */
+
+/* Checks whether SPTE's page was evicted so recently that it would
+   still be resident with one more frame of memory per eviction since.
+   This stands in for the non-resident (ghost) lists of CLOCK-Pro and
+   2Q: a refaulting page has a reuse distance shorter than memory. */
+bool vm_policy_is_refault(struct spt_entry *spte)
+{
+    return spte->evict_stamp != 0 && evict_cnt - spte->evict_stamp < frame_cnt;
+}
+
+static void no_init(void) {}
+static void no_frame_hook(struct frame *frame UNUSED) {}
+static void no_access_hook(struct frame *frame UNUSED, struct spt_entry *spte UNUSED) {}
+
+/* Clock: the one-handed clock, giving accessed frames a second chance. */
+static struct frame *clock_select_victim(void)
+{
+    struct frame *frame = frame_clock_advance();
+    while (frame_is_accessed(frame))
+    {
+        frame_clear_accessed(frame);
+        frame = frame_clock_advance();
+    }
+    return frame;
+}
+
+/* WSClock: frames accessed within the last WSCLOCK_TAU ticks form the
+   working set and are skipped.  Old clean frames are evicted.  Old
+   dirty frames are passed over, since the victim search runs with the
+   frame table locked; the reclaim thread cleans them in the background
+   without the lock.  If a whole revolution finds no old clean frame,
+   the first old dirty one goes, written back by eviction with the locks
+   dropped, or else the hand's frame. */
+static struct frame *wsclock_select_victim(void)
+{
+    int64_t now = timer_ticks();
+    struct frame *dirty_victim = NULL;
+    size_t i;
+
+    for (i = 0; i < frame_cnt; i++)
+    {
+        struct frame *frame = frame_clock_advance();
+        if (frame_is_accessed(frame))
+        {
+            frame_clear_accessed(frame);
+            frame->last_used = now;
+            continue;
+        }
+        if (now - frame->last_used <= WSCLOCK_TAU)
+            continue;
+        if (!frame_is_dirty(frame))
+            return frame;
+        if (dirty_victim == NULL)
+            dirty_victim = frame;
+    }
+    return dirty_victim != NULL ? dirty_victim : frame_clock_advance();
+}
+
+static void wsclock_on_insert(struct frame *frame)
+{
+    frame->last_used = timer_ticks();
+}
+
+/* CLOCK-Pro, approximated with a single hand.  Frames start cold and
+   in their test period; a cold frame accessed during its test period
+   becomes hot, and a refaulting page is hot straight away.  Hot frames
+   that go a revolution without access are demoted to cold. */
+static size_t hot_cnt;
+
+static void clockpro_init(void)
+{
+    hot_cnt = 0;
+}
+
+static void clockpro_on_insert(struct frame *frame)
+{
+    frame->policy_bits = CP_TEST;
+}
+
+static void clockpro_on_remove(struct frame *frame)
+{
+    if (frame->policy_bits & CP_HOT)
+        hot_cnt--;
+}
+
+static void clockpro_on_access(struct frame *frame, struct spt_entry *spte)
+{
+    if (!(frame->policy_bits & CP_HOT) && vm_policy_is_refault(spte))
+    {
+        frame->policy_bits = CP_HOT;
+        hot_cnt++;
+    }
+}
+
+static struct frame *clockpro_select_victim(void)
+{
+    size_t hot_target = frame_cnt * 3 / 4;
+    size_t i;
+
+    for (i = 0; i < 3 * frame_cnt; i++)
+    {
+        struct frame *frame = frame_clock_advance();
+        bool accessed = frame_is_accessed(frame);
+        if (accessed)
+            frame_clear_accessed(frame);
+
+        if (frame->policy_bits & CP_HOT)
+        {
+            if (!accessed)
+            {
+                frame->policy_bits = 0;
+                hot_cnt--;
+            }
+        }
+        else if (accessed)
+        {
+            if ((frame->policy_bits & CP_TEST) && hot_cnt < hot_target)
+            {
+                frame->policy_bits = CP_HOT;
+                hot_cnt++;
+            }
+            else
+                frame->policy_bits = CP_TEST;
+        }
+        else
+            return frame;
+    }
+    return frame_clock_advance();
+}
+
+/* 2Q: new frames enter the A1 FIFO and are evicted from it in order
+   unless A1 is within its share of memory.  Refaulting pages enter
+   Am, which approximates LRU with second chance on accessed bits. */
+static struct list a1_list;
+static struct list am_list;
+static size_t a1_cnt;
+
+static void twoq_init(void)
+{
+    list_init(&a1_list);
+    list_init(&am_list);
+    a1_cnt = 0;
+}
+
+static void twoq_on_insert(struct frame *frame)
+{
+    frame->policy_bits = Q_A1;
+    list_push_back(&a1_list, &frame->policy_elem);
+    a1_cnt++;
+}
+
+static void twoq_on_remove(struct frame *frame)
+{
+    if (frame->policy_bits & Q_A1)
+        a1_cnt--;
+    list_remove(&frame->policy_elem);
+}
+
+static void twoq_on_access(struct frame *frame, struct spt_entry *spte)
+{
+    if ((frame->policy_bits & Q_A1) && vm_policy_is_refault(spte))
+    {
+        list_remove(&frame->policy_elem);
+        a1_cnt--;
+        frame->policy_bits = Q_AM;
+        list_push_back(&am_list, &frame->policy_elem);
+    }
+}
+
+static struct frame *twoq_select_victim(void)
+{
+    if (!list_empty(&a1_list) && (a1_cnt > frame_cnt / 4 || list_empty(&am_list)))
+        return list_entry(list_front(&a1_list), struct frame, policy_elem);
+
+    size_t i, am_cnt = list_size(&am_list);
+    for (i = 0; i < am_cnt; i++)
+    {
+        struct frame *frame = list_entry(list_front(&am_list), struct frame, policy_elem);
+        if (!frame_is_accessed(frame))
+            return frame;
+        frame_clear_accessed(frame);
+        list_push_back(&am_list, list_pop_front(&am_list));
+    }
+    return list_entry(list_front(&am_list), struct frame, policy_elem);
+}
+
+static const struct vm_policy policies[] = {
+    {"clock", no_init, no_frame_hook, no_frame_hook, no_access_hook,
+     clock_select_victim},
+    {"wsclock", no_init, wsclock_on_insert, no_frame_hook, no_access_hook,
+     wsclock_select_victim},
+    {"clockpro", clockpro_init, clockpro_on_insert, clockpro_on_remove,
+     clockpro_on_access, clockpro_select_victim},
+    {"2q", twoq_init, twoq_on_insert, twoq_on_remove, twoq_on_access,
+     twoq_select_victim},
+};
+
+/* Policy in use, selected by -vmpolicy=. */
+const struct vm_policy *vm_policy = &policies[0];
+
+/* Selects the policy called NAME.  Returns false if there is none. */
+bool vm_policy_select(const char *name)
+{
+    size_t i;
+    for (i = 0; i < sizeof policies / sizeof *policies; i++)
+        if (!strcmp(policies[i].name, name))
+        {
+            vm_policy = &policies[i];
+            return true;
+        }
+    return false;
+}
+
+void vm_policy_init(void)
+{
+    vm_policy->init();
+}
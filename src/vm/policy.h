@@ -0,0 +1,26 @@
+#ifndef VM_POLICY_H
+#define VM_POLICY_H
+
+#include <stdbool.h>
+
+struct frame;
+struct spt_entry;
+
+/* A page replacement policy.  Every hook is called with
+   clock_list_lock held. */
+struct vm_policy {
+  const char *name;                                     /* Name for -vmpolicy= */
+  void (*init) (void);                                  /* Sets up policy state */
+  void (*on_insert) (struct frame *);                   /* Frame enters the frame table */
+  void (*on_remove) (struct frame *);                   /* Frame leaves the frame table */
+  void (*on_access) (struct frame *, struct spt_entry *); /* SPTE's page is faulted into frame */
+  struct frame *(*select_victim) (void);                /* Chooses the frame to evict */
+};
+
+extern const struct vm_policy *vm_policy;
+
+bool vm_policy_select(const char *name);
+void vm_policy_init(void);
+bool vm_policy_is_refault(struct spt_entry *spte);
+
+#endif
@@ -0,0 +1,191 @@
+#include "vm/reclaim.h"
+#include <bitmap.h>
+#include <list.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/shrinker.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/frame.h"
+
+/* Background reclaim.  Once free user frames drop below the low
+   watermark, the reclaim thread evicts until they are back at the high
+   watermark.  Before evicting it pre-cleans idle dirty frames, so that
+   the clean list holds victims that can be dropped without any I/O.
+   The clean list and the cleaner hand are protected by clock_list_lock. */
+
+static size_t low_wmark;
+static size_t high_wmark;
+
+static struct semaphore reclaim_sema;   /* Wakes the reclaim thread */
+static bool reclaim_pending;            /* Reclaim thread was woken */
+
+static struct list clean_list;          /* Frames cleaned and not used since */
+static size_t clean_cnt;
+static struct list_elem *clean_hand;    /* Cleaner's position in clock_list */
+
+static unsigned long long background_cnt;  /* Frames reclaimed by the thread */
+static unsigned long long precleaned_cnt;  /* Dirty frames written back early */
+static unsigned long long stall_cnt;       /* Allocations that had to evict */
+static unsigned long long deactivated_cnt; /* Frames dropped behind sequential readers */
+
+static void reclaim_thread(void *aux UNUSED);
+
+/* Sets the watermarks from the memory free for user frames and starts
+   the reclaim thread. */
+void reclaim_init(void)
+{
+    size_t user_pages = frame_free_cnt();
+
+    low_wmark = user_pages / 32 + 2;
+    high_wmark = 2 * low_wmark;
+    sema_init(&reclaim_sema, 0);
+    reclaim_pending = false;
+    list_init(&clean_list);
+    clean_cnt = 0;
+    clean_hand = NULL;
+    thread_create("reclaim", PRI_DEFAULT, reclaim_thread, NULL);
+}
+
+/* Called by allocate_frame with clock_list_lock held after each frame
+   allocation.  STALLED tells whether the allocation had to evict. */
+void reclaim_note_alloc(bool stalled)
+{
+    if (stalled)
+        stall_cnt++;
+    if (!reclaim_pending && frame_free_cnt() < low_wmark)
+    {
+        reclaim_pending = true;
+        sema_up(&reclaim_sema);
+    }
+}
+
+/* Takes the oldest frame off the clean list that is still clean and
+   was not accessed since it was cleaned.  Frames used in the meantime
+   are dropped from the list.  Returns NULL if there is none. */
+struct frame *reclaim_clean_victim(void)
+{
+    while (!list_empty(&clean_list))
+    {
+        struct frame *frame = list_entry(list_pop_front(&clean_list), struct frame, clean_elem);
+        frame->clean_listed = false;
+        clean_cnt--;
+        if (frame->pin_cnt == 0 && !frame_is_accessed(frame) && !frame_is_dirty(frame))
+            return frame;
+    }
+    return NULL;
+}
+
+/* Forgets FRAME, which is leaving the frame table. */
+void reclaim_forget(struct frame *frame)
+{
+    if (clean_hand == &frame->clock_elem)
+        clean_hand = list_next(clean_hand);
+    if (frame->clean_listed)
+    {
+        list_remove(&frame->clean_elem);
+        frame->clean_listed = false;
+        clean_cnt--;
+    }
+}
+
+/* Puts FRAME, which its process does not expect to use again, first
+   in line for eviction if it can be dropped without I/O. */
+void reclaim_deactivate(struct frame *frame)
+{
+    struct spt_entry *spte = frame_spte(frame);
+
+    frame_clear_accessed(frame);
+    if (frame->clean_listed || spte == NULL || frame_is_dirty(frame)
+        || (spte->type == SWAP && frame->swap_slot == BITMAP_ERROR))
+        return;
+    list_push_front(&clean_list, &frame->clean_elem);
+    frame->clean_listed = true;
+    clean_cnt++;
+    deactivated_cnt++;
+}
+
+/* Advances the cleaner hand and returns the frame under it.  The
+   cleaner has its own hand so that it does not disturb the clock. */
+static struct frame *clean_hand_advance(void)
+{
+    if (clean_hand == NULL || clean_hand == list_end(&clock_list)
+        || list_next(clean_hand) == list_end(&clock_list))
+        clean_hand = list_begin(&clock_list);
+    else
+        clean_hand = list_next(clean_hand);
+    return list_entry(clean_hand, struct frame, clock_elem);
+}
+
+/* Writes back dirty frames that were not accessed since the policy
+   last looked at them, until the clean list holds enough victims to
+   refill free memory up to the high watermark.  The lock is dropped
+   during each write, so faults don't wait for the disk. */
+static void preclean(void)
+{
+    size_t scanned;
+
+    for (scanned = 0; ; scanned++)
+    {
+        lock_acquire(&clock_list_lock);
+        if (scanned >= frame_cnt || clean_cnt >= high_wmark)
+        {
+            lock_release(&clock_list_lock);
+            return;
+        }
+
+        /* Accessed bits are left alone; they belong to the policy. */
+        struct frame *frame = clean_hand_advance();
+        if (!frame->clean_listed && frame->pce == NULL && frame->pin_cnt == 0
+            && !list_empty(&frame->map_list) && !frame_is_accessed(frame))
+        {
+            bool dirty = frame_is_dirty(frame);
+            /* The lock is dropped during the write, in which time the
+               frame may have been put on the list by drop-behind. */
+            if (frame_clean_unlocked(frame) && !frame->clean_listed)
+            {
+                if (dirty)
+                    precleaned_cnt++;
+                list_push_back(&clean_list, &frame->clean_elem);
+                frame->clean_listed = true;
+                clean_cnt++;
+            }
+        }
+        lock_release(&clock_list_lock);
+    }
+}
+
+static void reclaim_thread(void *aux UNUSED)
+{
+    for (;;)
+    {
+        sema_down(&reclaim_sema);
+
+        /* Caches go first; they cost no I/O. */
+        size_t free_cnt = frame_free_cnt();
+        if (free_cnt < high_wmark)
+            shrink_caches(PAL_USER, high_wmark - free_cnt);
+        preclean();
+
+        lock_acquire(&clock_list_lock);
+        while (frame_free_cnt() < high_wmark && frame_cnt > 0)
+        {
+            evict_frames();
+            background_cnt++;
+
+            /* Let faulting threads in between evictions. */
+            lock_release(&clock_list_lock);
+            lock_acquire(&clock_list_lock);
+        }
+        reclaim_pending = false;
+        lock_release(&clock_list_lock);
+    }
+}
+
+/* Prints background reclaim statistics. */
+void reclaim_print_stats(void)
+{
+    printf("Reclaim: %llu frames reclaimed in background, %llu pre-cleaned, "
+           "%llu dropped behind, %llu allocations stalled\n",
+           background_cnt, precleaned_cnt, deactivated_cnt, stall_cnt);
+}
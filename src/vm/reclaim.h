@@ -0,0 +1,15 @@
+#ifndef VM_RECLAIM_H
+#define VM_RECLAIM_H
+
+#include <stdbool.h>
+
+struct frame;
+
+void reclaim_init(void);
+void reclaim_note_alloc(bool stalled);
+struct frame *reclaim_clean_victim(void);
+void reclaim_forget(struct frame *frame);
+void reclaim_deactivate(struct frame *frame);
+void reclaim_print_stats(void);
+
+#endif
@@ -0,0 +1,143 @@
+#include "vm/rss.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+
+/* Resident sets.  Each process counts the frame mappings it holds in
+   its rss.  A process over the soft limit is the first to lose frames
+   when memory runs short; a process at the hard limit replaces one of
+   its own pages for every new one.
+
+   When a soft limit is set, the wsample thread estimates working set
+   sizes by sampling accessed bits once per WS_PERIOD.  The bits it
+   takes are kept in the frames' referenced flags, so the replacement
+   policy still sees them.  Soft limit reclaim goes first to the process
+   with the most resident pages beyond its working set, which it can
+   lose with the fewest refaults. */
+
+#define WS_PERIOD TIMER_FREQ
+
+static unsigned long long soft_evict_cnt;  /* Frames taken over the soft limit */
+static unsigned long long hard_evict_cnt;  /* Frames replaced at the hard limit */
+
+static void wsample_thread(void *aux UNUSED);
+
+/* Starts the working set sampler, if there is a soft limit to apply. */
+void rss_init(void)
+{
+    if (rss_soft_limit == 0)
+        return;
+    thread_create("wsample", PRI_DEFAULT, wsample_thread, NULL);
+}
+
+/* Checks whether T holds as many frames as the hard limit allows. */
+bool rss_at_hard_limit(struct thread *t)
+{
+    return rss_hard_limit != 0 && t->rss >= rss_hard_limit;
+}
+
+/* Keeps the current process under the hard limit by evicting one of
+   its own frames before it gets a new one.  Must be called with
+   clock_list_lock held. */
+void rss_enforce_hard_limit(void)
+{
+    struct thread *cur = thread_current();
+    if (rss_at_hard_limit(cur) && frame_evict_owned(cur))
+        hard_evict_cnt++;
+}
+
+/* Returns the number of T's resident pages beyond its working set. */
+static size_t rss_excess(struct thread *t)
+{
+    return t->rss > t->wss ? t->rss - t->wss : 0;
+}
+
+static void find_over_soft(struct thread *t, void *aux)
+{
+    struct thread **worst = aux;
+    if (t->rss <= rss_soft_limit)
+        return;
+    if (*worst == NULL || rss_excess(t) > rss_excess(*worst)
+        || (rss_excess(t) == rss_excess(*worst) && t->rss > (*worst)->rss))
+        *worst = t;
+}
+
+/* Picks a frame of the process over the soft limit with the most
+   resident pages outside its working set, the larger process breaking
+   ties.  Returns NULL if no process is over it.  Must be called with
+   clock_list_lock held. */
+struct frame *rss_select_victim(void)
+{
+    if (rss_soft_limit == 0)
+        return NULL;
+
+    struct thread *worst = NULL;
+    enum intr_level old_level = intr_disable();
+    thread_foreach(find_over_soft, &worst);
+    intr_set_level(old_level);
+    if (worst == NULL)
+        return NULL;
+
+    struct frame *frame = frame_select_owned(worst);
+    if (frame != NULL)
+        soft_evict_cnt++;
+    return frame;
+}
+
+static void update_wss(struct thread *t, void *aux UNUSED)
+{
+    t->wss = (t->wss + t->ws_sample + 1) / 2;
+    t->ws_sample = 0;
+}
+
+/* Takes the accessed bit of every mapping, counting it for the owner. */
+static void sample_accessed(void)
+{
+    struct list_elem *e, *m;
+
+    lock_acquire(&clock_list_lock);
+    for (e = list_begin(&clock_list); e != list_end(&clock_list); e = list_next(e))
+    {
+        struct frame *frame = list_entry(e, struct frame, clock_elem);
+        for (m = list_begin(&frame->map_list); m != list_end(&frame->map_list); m = list_next(m))
+        {
+            struct frame_map *map = list_entry(m, struct frame_map, elem);
+            if (pagedir_is_accessed(map->pagedir, map->spte->vaddr))
+            {
+                map->owner->ws_sample++;
+                pagedir_set_accessed(map->pagedir, map->spte->vaddr, false);
+                frame->referenced = true;
+            }
+        }
+    }
+    lock_release(&clock_list_lock);
+}
+
+/* Every WS_PERIOD, folds the pages each process touched into a
+   decaying average of its working set size. */
+static void wsample_thread(void *aux UNUSED)
+{
+    for (;;)
+    {
+        timer_sleep(WS_PERIOD);
+        sample_accessed();
+
+        enum intr_level old_level = intr_disable();
+        thread_foreach(update_wss, NULL);
+        intr_set_level(old_level);
+    }
+}
+
+/* Prints resident set limit statistics. */
+void rss_print_stats(void)
+{
+    printf("RSS: soft limit %zu, hard limit %zu, %llu frames over soft limit, "
+           "%llu replaced at hard limit\n",
+           rss_soft_limit, rss_hard_limit, soft_evict_cnt, hard_evict_cnt);
+}
@@ -0,0 +1,21 @@
+#ifndef VM_RSS_H
+#define VM_RSS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct frame;
+struct thread;
+
+/* Resident set limits in pages, 0 for none.  Set by -rss-soft= and
+   -rss-hard= and applied to every process. */
+size_t rss_soft_limit;
+size_t rss_hard_limit;
+
+void rss_init(void);
+bool rss_at_hard_limit(struct thread *t);
+void rss_enforce_hard_limit(void);
+struct frame *rss_select_victim(void);
+void rss_print_stats(void);
+
+#endif
@@ -0,0 +1,226 @@
+#include "vm/vma.h"
+#include <debug.h>
+#include <round.h>
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Every process keeps its regions in an AVL tree ordered by start
+   address, so that finding the region of an address, checking a new
+   mapping for overlaps, and adding or removing a region take
+   O(log regions) however many pages they cover.  The executable's
+   segments and memory mappings are regions; the stack, which grows a
+   page at a time, is made of plain sptes.
+
+   madvise() hints are kept per region, so advising part of a region
+   splits it.  The pieces of a memory mapping stay next to each other
+   in the tree, and the mapping points at the first. */
+
+static bool vma_less(const struct avl_elem *a, const struct avl_elem *b, void *aux UNUSED)
+{
+    return avl_entry(a, struct vma, elem)->start < avl_entry(b, struct vma, elem)->start;
+}
+
+void vma_init(struct avl *vmas)
+{
+    avl_init(vmas, vma_less, NULL);
+}
+
+/* Adds the region of LENGTH bytes at START, which must be page aligned
+   and free, to VMAS. The first READ_BYTES bytes are read from FILE
+   at OFFSET and the rest are zeros. Returns NULL if out of memory. */
+struct vma *vma_create(struct avl *vmas, void *start, size_t length,
+                       enum spt_page_type type, struct file *file, off_t offset,
+                       size_t read_bytes, bool writable)
+{
+    ASSERT(pg_ofs(start) == 0);
+    ASSERT(length > 0);
+
+    struct vma *vma = malloc(sizeof(struct vma));
+    if (vma == NULL)
+        return NULL;
+    vma->start = start;
+    vma->end = (uint8_t *) start + ROUND_UP(length, PGSIZE);
+    vma->type = type;
+    vma->file = file;
+    vma->offset = offset;
+    vma->read_bytes = read_bytes;
+    vma->writable = writable;
+    vma->advice = ADVICE_NORMAL;
+    vma->mmape = NULL;
+    avl_insert(vmas, &vma->elem);
+    return vma;
+}
+
+/* Removes VMA from VMAS and frees it. Sptes made from it must be
+   deleted by the caller. */
+void vma_remove(struct avl *vmas, struct vma *vma)
+{
+    avl_delete(vmas, &vma->elem);
+    free(vma);
+}
+
+/* Splits VMA at ADDR, a page boundary inside it, into two regions.
+   VMA keeps the lower part. Returns the upper part, or NULL if out of
+   memory. */
+struct vma *vma_split(struct avl *vmas, struct vma *vma, void *addr)
+{
+    uint8_t *mid = addr;
+    ASSERT(pg_ofs(addr) == 0);
+    ASSERT(mid > vma->start && mid < vma->end);
+
+    struct vma *upper = malloc(sizeof(struct vma));
+    if (upper == NULL)
+        return NULL;
+    size_t ofs = mid - vma->start;
+    *upper = *vma;
+    upper->start = mid;
+    upper->offset = vma->offset + ofs;
+    upper->read_bytes = vma->read_bytes > ofs ? vma->read_bytes - ofs : 0;
+    vma->end = mid;
+    if (vma->read_bytes > ofs)
+        vma->read_bytes = ofs;
+    avl_insert(vmas, &upper->elem);
+    return upper;
+}
+
+/* Records ADVICE for the regions of VMAS in [START, END), splitting
+   those that reach past either end. Pages outside any region are
+   skipped. Returns false if out of memory. */
+bool vma_advise(struct avl *vmas, void *start, void *end, enum spt_advice advice)
+{
+    uint8_t *p = start;
+    while (p < (uint8_t *) end)
+    {
+        struct vma *vma = vma_find(vmas, p);
+        if (vma == NULL)
+        {
+            p += PGSIZE;
+            continue;
+        }
+        if (vma->advice != advice)
+        {
+            if (vma->start < p && (vma = vma_split(vmas, vma, p)) == NULL)
+                return false;
+            if (vma->end > (uint8_t *) end && vma_split(vmas, vma, end) == NULL)
+                return false;
+            vma->advice = advice;
+        }
+        p = vma->end;
+    }
+    return true;
+}
+
+/* Returns the hint given for the page at VADDR, which is ADVICE_NORMAL
+   outside any region of VMAS. */
+enum spt_advice vma_advice(struct avl *vmas, const void *vaddr)
+{
+    struct vma *vma = vma_find(vmas, vaddr);
+    return vma != NULL ? vma->advice : ADVICE_NORMAL;
+}
+
+/* Returns the region after VMA in VMAS if it belongs to the same
+   memory mapping, or else NULL. */
+static struct vma *vma_next_piece(struct avl *vmas, struct vma *vma)
+{
+    struct avl_elem *e = avl_next(vmas, &vma->elem);
+    if (e == NULL || avl_entry(e, struct vma, elem)->mmape != vma->mmape)
+        return NULL;
+    return avl_entry(e, struct vma, elem);
+}
+
+/* Returns the end of the memory mapping whose first region is FIRST. */
+void *vma_mapping_end(struct avl *vmas, struct vma *first)
+{
+    struct vma *vma = first, *next;
+    while ((next = vma_next_piece(vmas, vma)) != NULL)
+        vma = next;
+    return vma->end;
+}
+
+/* Removes every region of the memory mapping whose first region is
+   FIRST. */
+void vma_remove_mapping(struct avl *vmas, struct vma *first)
+{
+    struct vma *vma = first;
+    while (vma != NULL)
+    {
+        struct vma *next = vma_next_piece(vmas, vma);
+        vma_remove(vmas, vma);
+        vma = next;
+    }
+}
+
+static void vma_free(struct avl_elem *e, void *aux UNUSED)
+{
+    free(avl_entry(e, struct vma, elem));
+}
+
+/* Frees every region in VMAS. */
+void vma_destroy(struct avl *vmas)
+{
+    avl_clear(vmas, vma_free);
+}
+
+/* Returns the region of VMAS holding VADDR, or NULL. */
+struct vma *vma_find(struct avl *vmas, const void *vaddr)
+{
+    struct vma key = { .start = pg_round_down(vaddr) };
+
+    struct avl_elem *e = avl_floor(vmas, &key.elem);
+    if (e == NULL)
+        return NULL;
+    struct vma *vma = avl_entry(e, struct vma, elem);
+    return (const uint8_t *) vaddr < vma->end ? vma : NULL;
+}
+
+/* Checks whether any region of VMAS overlaps the LENGTH bytes at START. */
+bool vma_overlaps(struct avl *vmas, const void *start, size_t length)
+{
+    /* Only the last region starting before the range ends can reach it. */
+    struct vma key = { .start = (uint8_t *) start + length - 1 };
+
+    struct avl_elem *e = avl_floor(vmas, &key.elem);
+    return e != NULL && avl_entry(e, struct vma, elem)->end > (const uint8_t *) start;
+}
+
+/* Makes and inserts the spte for VMA's page at VADDR, on the first
+   touch of the page. Returns NULL if out of memory. */
+struct spt_entry *vma_fault_in(struct vma *vma, void *vaddr)
+{
+    uint8_t *upage = pg_round_down(vaddr);
+    size_t ofs = upage - vma->start;
+    size_t read_bytes = 0;
+
+    if (vma->read_bytes > ofs)
+        read_bytes = vma->read_bytes - ofs < PGSIZE ? vma->read_bytes - ofs : PGSIZE;
+
+    struct spt_entry *spte = malloc(sizeof(struct spt_entry));
+    if (spte == NULL)
+        return NULL;
+    spte_initialize(spte, vma->type, upage, vma->file, vma->writable, false,
+                    vma->offset + ofs, read_bytes, PGSIZE - read_bytes);
+    if (vma->mmape != NULL)
+        list_push_back(&vma->mmape->spte_list, &spte->mmap_elem);
+    insert_spte(&thread_current()->spt, spte);
+    return spte;
+}
+
+/* Copies the regions of PARENT_VMAS that don't belong to a memory
+   mapping into VMAS; fork copies mappings itself. */
+bool vma_fork(struct avl *vmas, struct avl *parent_vmas)
+{
+    struct avl_elem *e;
+    for (e = avl_first(parent_vmas); e != NULL; e = avl_next(parent_vmas, e))
+    {
+        struct vma *pvma = avl_entry(e, struct vma, elem);
+        if (pvma->mmape != NULL)
+            continue;
+        struct vma *vma = vma_create(vmas, pvma->start, pvma->end - pvma->start, pvma->type,
+                                     pvma->file, pvma->offset, pvma->read_bytes, pvma->writable);
+        if (vma == NULL)
+            return false;
+        vma->advice = pvma->advice;
+    }
+    return true;
+}
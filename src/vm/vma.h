@@ -0,0 +1,42 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+
+#include <avl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/page.h"
+
+/* A region of a process's address space: pages that share their
+   backing and protection.  Supplemental page table entries for its
+   pages are made from it when the pages are first touched. */
+struct vma {
+  uint8_t *start;               /* First page of the region */
+  uint8_t *end;                 /* Page after the region */
+  enum spt_page_type type;      /* ZERO for private memory, FILE for a shared mapping */
+  struct file *file;            /* File the pages are read from, or NULL */
+  off_t offset;                 /* Offset in FILE of the first page */
+  size_t read_bytes;            /* Bytes of FILE that back the region */
+  bool writable;                /* Whether the pages may be written */
+  enum spt_advice advice;       /* Access pattern hint from madvise() */
+  struct mmap_entry *mmape;     /* Mapping the region belongs to, or NULL */
+  struct avl_elem elem;         /* Allows insertion into a thread's vmas */
+};
+
+void vma_init(struct avl *vmas);
+struct vma *vma_create(struct avl *vmas, void *start, size_t length,
+                       enum spt_page_type type, struct file *file, off_t offset,
+                       size_t read_bytes, bool writable);
+void vma_remove(struct avl *vmas, struct vma *vma);
+struct vma *vma_split(struct avl *vmas, struct vma *vma, void *addr);
+bool vma_advise(struct avl *vmas, void *start, void *end, enum spt_advice advice);
+enum spt_advice vma_advice(struct avl *vmas, const void *vaddr);
+void *vma_mapping_end(struct avl *vmas, struct vma *first);
+void vma_remove_mapping(struct avl *vmas, struct vma *first);
+void vma_destroy(struct avl *vmas);
+struct vma *vma_find(struct avl *vmas, const void *vaddr);
+bool vma_overlaps(struct avl *vmas, const void *start, size_t length);
+struct spt_entry *vma_fault_in(struct vma *vma, void *vaddr);
+bool vma_fork(struct avl *vmas, struct avl *parent_vmas);
+
+#endif
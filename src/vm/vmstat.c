@@ -0,0 +1,99 @@
+#include "vm/vmstat.h"
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/swap.h"
+#include "threads/thread.h"
+#include "vm/frame.h"
+
+/* VM event counters.  Every event is counted in vm_stats, and faults
+   and evictions also in the vmstat of the processes they concern:
+   the faulting process, or every process mapping an evicted frame.
+   Counters are bumped without a lock, like the other statistics, so a
+   reading taken while they change may be slightly off. */
+
+static struct vmstat vm_stats;
+
+/* Returns the CPU's time stamp counter, a clock fine enough to time
+   a single fault. */
+uint64_t vmstat_now(void)
+{
+    uint64_t tsc;
+    asm volatile("rdtsc" : "=A"(tsc));
+    return tsc;
+}
+
+/* Counts EVENT for the system only. */
+void vmstat_count(enum vm_event event)
+{
+    vm_stats.events[event]++;
+}
+
+/* Returns the latency histogram bucket of CYCLES. */
+static int lat_bucket(uint64_t cycles)
+{
+    int bucket = 0;
+    cycles >>= VMSTAT_LAT_SHIFT;
+    while (cycles > 0 && bucket < VMSTAT_LAT_BUCKETS - 1)
+    {
+        cycles >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Counts a fault of the current process served as EVENT, which began
+   at time stamp START. */
+void vmstat_fault(enum vm_event event, uint64_t start)
+{
+    struct vmstat *own = &thread_current()->vmstat;
+    int bucket = lat_bucket(vmstat_now() - start);
+
+    vm_stats.events[event]++;
+    vm_stats.fault_lat[bucket]++;
+    own->events[event]++;
+    own->fault_lat[bucket]++;
+}
+
+/* Counts the eviction of FRAME as EVENT, for the system and for each
+   process mapping it.  Must be called with clock_list_lock held. */
+void vmstat_evict(struct frame *frame, enum vm_event event)
+{
+    struct list_elem *elem;
+
+    vm_stats.events[event]++;
+    for (elem = list_begin(&frame->map_list); elem != list_end(&frame->map_list);
+         elem = list_next(elem))
+        list_entry(elem, struct frame_map, elem)->owner->vmstat.events[event]++;
+}
+
+/* Copies the statistics of process T, or of the whole system if T is
+   null, into STATS. */
+void vmstat_get(struct thread *t, struct vmstat *stats)
+{
+    *stats = t != NULL ? t->vmstat : vm_stats;
+    stats->swap_used = swap_used_cnt();
+}
+
+/* Prints VM event statistics. */
+void vmstat_print_stats(void)
+{
+    const unsigned long long *e = vm_stats.events;
+    int i;
+
+    printf("VM faults: %llu file, %llu zero, %llu swap, %llu stack, "
+           "%llu shared, %llu protection\n",
+           e[VM_FAULT_FILE], e[VM_FAULT_ZERO], e[VM_FAULT_SWAP],
+           e[VM_FAULT_STACK], e[VM_FAULT_SHARED], e[VM_FAULT_PROT]);
+    printf("VM evictions: %llu clean, %llu to swap, %llu to file; "
+           "%llu clock revolutions, %zu swap slots in use\n",
+           e[VM_EVICT_CLEAN], e[VM_EVICT_SWAP], e[VM_EVICT_FILE],
+           e[VM_CLOCK_WRAP], swap_used_cnt());
+    printf("VM fault latency (cycles):");
+    for (i = 0; i < VMSTAT_LAT_BUCKETS; i++)
+        if (vm_stats.fault_lat[i] != 0)
+            printf(" %s%u:%llu", i == VMSTAT_LAT_BUCKETS - 1 ? ">=" : "<",
+                   1u << (i + VMSTAT_LAT_SHIFT - (i == VMSTAT_LAT_BUCKETS - 1)),
+                   vm_stats.fault_lat[i]);
+    printf("\n");
+}
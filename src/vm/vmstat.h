@@ -0,0 +1,17 @@
+#ifndef VM_VMSTAT_H
+#define VM_VMSTAT_H
+
+#include <stdint.h>
+#include <vmstat.h>
+
+struct frame;
+struct thread;
+
+uint64_t vmstat_now(void);
+void vmstat_count(enum vm_event event);
+void vmstat_fault(enum vm_event event, uint64_t start);
+void vmstat_evict(struct frame *frame, enum vm_event event);
+void vmstat_get(struct thread *t, struct vmstat *stats);
+void vmstat_print_stats(void);
+
+#endif
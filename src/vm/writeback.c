@@ -0,0 +1,226 @@
+#include "vm/writeback.h"
+#include <list.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "vm/frame.h"
+
+/* Write-back of memory mapped files.  Every WB_PERIOD the flush
+   thread looks for frames of file mappings that have stayed dirty for
+   WB_AGE, queues up to WB_BATCH of them, and writes the queue in file
+   and offset order, so that the disk sees runs of neighbouring blocks
+   and write I/O is spread over time instead of piling up at munmap and
+   exit.  msync() writes a range at once or adds it to the queue.  The
+   queue and the frames' write-back state are protected by
+   clock_list_lock, which is dropped during each write so that faults
+   don't wait for the disk. */
+
+#define WB_PERIOD (TIMER_FREQ / 2)
+#define WB_AGE TIMER_FREQ
+#define WB_BATCH 32
+
+static struct list wb_list;             /* Frames waiting to be written back */
+static size_t wb_cnt;
+
+static unsigned long long flushed_cnt;  /* Pages written by the flush thread */
+static unsigned long long synced_cnt;   /* Pages written by msync, munmap and exit */
+static unsigned long long batch_cnt;    /* Passes that wrote anything */
+
+static void flush_thread(void *aux UNUSED);
+
+void writeback_init(void)
+{
+    list_init(&wb_list);
+    wb_cnt = 0;
+    thread_create("flush", PRI_DEFAULT, flush_thread, NULL);
+}
+
+/* Forgets FRAME, which is leaving the frame table. */
+void writeback_forget(struct frame *frame)
+{
+    if (frame->wb_queued)
+    {
+        list_remove(&frame->wb_elem);
+        frame->wb_queued = false;
+        wb_cnt--;
+    }
+}
+
+static void writeback_queue(struct frame *frame)
+{
+    if (frame->wb_queued)
+        return;
+    list_push_back(&wb_list, &frame->wb_elem);
+    frame->wb_queued = true;
+    wb_cnt++;
+}
+
+/* Orders queued frames by the file they belong to, then by offset. */
+static bool wb_less(const struct list_elem *a_, const struct list_elem *b_, void *aux UNUSED)
+{
+    struct spt_entry *a = frame_spte(list_entry(a_, struct frame, wb_elem));
+    struct spt_entry *b = frame_spte(list_entry(b_, struct frame, wb_elem));
+
+    if (a == NULL || b == NULL)
+        return a == NULL && b != NULL;
+    struct inode *a_inode = file_get_inode(a->file);
+    struct inode *b_inode = file_get_inode(b->file);
+    if (a_inode != b_inode)
+        return a_inode < b_inode;
+    return a->offset < b->offset;
+}
+
+/* Checks whether FRAME holds a page of a file mapping. */
+static bool frame_is_mapped_file(struct frame *frame)
+{
+    struct spt_entry *spte = frame_spte(frame);
+    return spte != NULL && spte->type == FILE && frame->pce == NULL;
+}
+
+/* Queues the frames of file mappings that have been dirty for WB_AGE. */
+static void writeback_scan(void)
+{
+    int64_t now = timer_ticks();
+    struct list_elem *e;
+
+    lock_acquire(&clock_list_lock);
+    for (e = list_begin(&clock_list); e != list_end(&clock_list); e = list_next(e))
+    {
+        struct frame *frame = list_entry(e, struct frame, clock_elem);
+        if (!frame_is_mapped_file(frame))
+            continue;
+        if (!frame_is_dirty(frame))
+            frame->dirty_since = 0;
+        else if (frame->dirty_since == 0)
+            frame->dirty_since = now;
+        else if (now - frame->dirty_since >= WB_AGE && wb_cnt < WB_BATCH)
+            writeback_queue(frame);
+    }
+    list_sort(&wb_list, wb_less, NULL);
+    lock_release(&clock_list_lock);
+}
+
+/* Writes back the queued frames in order. */
+static void writeback_drain(void)
+{
+    bool wrote = false;
+
+    for (;;)
+    {
+        lock_acquire(&clock_list_lock);
+        if (list_empty(&wb_list))
+        {
+            lock_release(&clock_list_lock);
+            break;
+        }
+        struct frame *frame = list_entry(list_pop_front(&wb_list), struct frame, wb_elem);
+        frame->wb_queued = false;
+        wb_cnt--;
+        if (frame_is_mapped_file(frame) && frame_is_dirty(frame) && frame_clean_unlocked(frame))
+        {
+            flushed_cnt++;
+            wrote = true;
+        }
+        frame->dirty_since = 0;
+        lock_release(&clock_list_lock);
+    }
+    if (wrote)
+        batch_cnt++;
+}
+
+static void flush_thread(void *aux UNUSED)
+{
+    for (;;)
+    {
+        timer_sleep(WB_PERIOD);
+        writeback_scan();
+        writeback_drain();
+    }
+}
+
+/* Orders a mapping's sptes by file offset. */
+static bool spte_offset_less(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+{
+    return list_entry(a, struct spt_entry, mmap_elem)->offset
+           < list_entry(b, struct spt_entry, mmap_elem)->offset;
+}
+
+/* Writes back the dirty pages of MMAPE between START and END in offset
+   order before returning if SYNC is true, or else leaves them to the
+   flush thread's next pass. */
+void writeback_mapping(struct mmap_entry *mmape, void *start, void *end, bool sync)
+{
+    struct list_elem *e;
+
+    list_sort(&mmape->spte_list, spte_offset_less, NULL);
+    for (e = list_begin(&mmape->spte_list); e != list_end(&mmape->spte_list); e = list_next(e))
+    {
+        struct spt_entry *spte = list_entry(e, struct spt_entry, mmap_elem);
+        if (spte->vaddr < start || spte->vaddr >= end)
+            continue;
+
+        lock_acquire(&clock_list_lock);
+        struct frame *frame = spte->frame;
+        if (frame != NULL && frame_is_dirty(frame))
+        {
+            if (!sync)
+                writeback_queue(frame);
+            else if (frame_clean_unlocked(frame))
+            {
+                frame->dirty_since = 0;
+                synced_cnt++;
+            }
+        }
+        lock_release(&clock_list_lock);
+    }
+}
+
+/* Writes back the dirty pages of every file mapping of T, which is
+   exiting, in a single pass sorted by file and offset across all the
+   mappings.  The frames are pinned and marked queued while they wait,
+   so that they are neither evicted nor put on the flush queue. */
+void writeback_exit(struct thread *t)
+{
+    struct list batch;
+    struct list_elem *m, *e;
+
+    list_init(&batch);
+    lock_acquire(&clock_list_lock);
+    for (m = list_begin(&t->mmap_list); m != list_end(&t->mmap_list); m = list_next(m))
+    {
+        struct mmap_entry *mmape = list_entry(m, struct mmap_entry, elem);
+        for (e = list_begin(&mmape->spte_list); e != list_end(&mmape->spte_list); e = list_next(e))
+        {
+            struct frame *frame = list_entry(e, struct spt_entry, mmap_elem)->frame;
+            if (frame == NULL || !frame_is_mapped_file(frame) || !frame_is_dirty(frame))
+                continue;
+            writeback_forget(frame);
+            frame->wb_queued = true;
+            frame_pin(frame);
+            list_push_back(&batch, &frame->wb_elem);
+        }
+    }
+    list_sort(&batch, wb_less, NULL);
+
+    while (!list_empty(&batch))
+    {
+        struct frame *frame = list_entry(list_pop_front(&batch), struct frame, wb_elem);
+        if (frame_clean_unlocked(frame))
+        {
+            frame->dirty_since = 0;
+            synced_cnt++;
+        }
+        frame->wb_queued = false;
+        frame_unpin(frame);
+    }
+    lock_release(&clock_list_lock);
+}
+
+/* Prints write-back statistics. */
+void writeback_print_stats(void)
+{
+    printf("Writeback: %llu pages flushed in %llu batches, %llu synced\n",
+           flushed_cnt, batch_cnt, synced_cnt);
+}
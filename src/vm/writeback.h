@@ -0,0 +1,16 @@
+#ifndef VM_WRITEBACK_H
+#define VM_WRITEBACK_H
+
+#include <stdbool.h>
+
+struct frame;
+struct mmap_entry;
+struct thread;
+
+void writeback_init(void);
+void writeback_forget(struct frame *frame);
+void writeback_exit(struct thread *t);
+void writeback_mapping(struct mmap_entry *mmape, void *start, void *end, bool sync);
+void writeback_print_stats(void);
+
+#endif
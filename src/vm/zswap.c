@@ -0,0 +1,194 @@
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <lz.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Compressed swap.  Pages on their way to swap are compressed into an
+   arena of kernel pages instead, and only go to the swap device when
+   the arena is full or the page does not compress well.  A page keeps
+   the swap slot it was given, which only serves as its name while it
+   lives in the arena. */
+
+/* Arena pages, unless -zswap= says otherwise; 0 disables zswap. */
+#define ZSWAP_DEFAULT_PAGES 32
+size_t zswap_pages = ZSWAP_DEFAULT_PAGES;
+
+/* The arena is handed out in units of this many bytes. */
+#define UNIT_SIZE 64
+
+/* Pages compressing to more than this go to the swap device. */
+#define MAX_COMPRESSED (PGSIZE / 2)
+
+/* Where the compressed copy of a swap slot lives. */
+struct zswap_entry {
+    uint32_t unit;              /* First arena unit plus 1, 0 if none */
+    uint16_t len;               /* Compressed size in bytes */
+};
+
+static struct lock zswap_lock;  /* Protects everything below */
+static uint8_t *arena;          /* Compressed pages */
+static struct bitmap *units;    /* Used arena units */
+static struct zswap_entry *entries;  /* One per swap slot */
+static size_t entry_cnt;
+
+/* Scratch space for compression. */
+static uint16_t htab[LZ_HTAB_SIZE];
+static uint8_t scratch[MAX_COMPRESSED];
+
+/* Statistics. */
+static unsigned long long store_cnt;     /* Pages stored */
+static unsigned long long reject_cnt;    /* Pages that did not compress */
+static unsigned long long full_cnt;      /* Pages that did not fit */
+static unsigned long long lookup_cnt;    /* Swap-ins asking zswap */
+static unsigned long long hit_cnt;       /* Swap-ins served by zswap */
+static unsigned long long raw_bytes;     /* Bytes of pages stored */
+static unsigned long long packed_bytes;  /* Bytes they compressed to */
+static unsigned long long compress_cycles;
+static unsigned long long decompress_cycles;
+
+/* Reads the CPU's time-stamp counter. */
+static inline uint64_t rdtsc(void)
+{
+    uint64_t tsc;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    return tsc;
+}
+
+/* Sets up an arena of zswap_pages kernel pages for the SLOT_CNT
+   swap slots.  zswap stays off if there is no swap or memory. */
+void zswap_init(size_t slot_cnt)
+{
+    lock_init(&zswap_lock);
+    if (zswap_pages == 0 || slot_cnt == 0)
+        return;
+
+    arena = palloc_get_multiple(0, zswap_pages);
+    units = bitmap_create(zswap_pages * PGSIZE / UNIT_SIZE);
+    entries = calloc(slot_cnt, sizeof *entries);
+    if (arena == NULL || units == NULL || entries == NULL)
+    {
+        printf("zswap: not enough memory--zswap disabled\n");
+        if (arena != NULL)
+            palloc_free_multiple(arena, zswap_pages);
+        if (units != NULL)
+            bitmap_destroy(units);
+        free(entries);
+        arena = NULL;
+        return;
+    }
+    entry_cnt = slot_cnt;
+}
+
+/* Drops SLOT's compressed copy.  Must be called with zswap_lock held. */
+static void entry_free(size_t slot)
+{
+    struct zswap_entry *e = &entries[slot];
+    if (e->unit != 0)
+    {
+        bitmap_set_multiple(units, e->unit - 1, DIV_ROUND_UP(e->len, UNIT_SIZE), false);
+        e->unit = 0;
+    }
+}
+
+/* Compresses PAGE into the arena as the contents of SLOT.  Returns
+   false if the page does not compress or the arena is full, and the
+   page must go to the swap device. */
+bool zswap_store(size_t slot, const void *page)
+{
+    if (arena == NULL)
+        return false;
+
+    lock_acquire(&zswap_lock);
+    entry_free(slot);
+
+    uint64_t start = rdtsc();
+    size_t len = lz_compress(page, PGSIZE, scratch, sizeof scratch, htab);
+    compress_cycles += rdtsc() - start;
+    if (len == 0)
+    {
+        reject_cnt++;
+        lock_release(&zswap_lock);
+        return false;
+    }
+
+    size_t unit = bitmap_scan_and_flip(units, 0, DIV_ROUND_UP(len, UNIT_SIZE), false);
+    if (unit == BITMAP_ERROR)
+    {
+        full_cnt++;
+        lock_release(&zswap_lock);
+        return false;
+    }
+    memcpy(arena + unit * UNIT_SIZE, scratch, len);
+    entries[slot].unit = unit + 1;
+    entries[slot].len = len;
+    store_cnt++;
+    raw_bytes += PGSIZE;
+    packed_bytes += len;
+    lock_release(&zswap_lock);
+    return true;
+}
+
+/* Decompresses SLOT into PAGE.  Returns false if SLOT is not held by
+   zswap.  The compressed copy stays until the slot is freed, since a
+   slot may be shared by several pages. */
+bool zswap_load(size_t slot, void *page)
+{
+    if (arena == NULL)
+        return false;
+
+    lock_acquire(&zswap_lock);
+    lookup_cnt++;
+    struct zswap_entry *e = &entries[slot];
+    bool hit = e->unit != 0;
+    if (hit)
+    {
+        uint64_t start = rdtsc();
+        size_t len = lz_decompress(arena + (e->unit - 1) * UNIT_SIZE, e->len, page, PGSIZE);
+        decompress_cycles += rdtsc() - start;
+        if (len != PGSIZE)
+            PANIC("zswap: slot %zu is corrupt", slot);
+        hit_cnt++;
+    }
+    lock_release(&zswap_lock);
+    return hit;
+}
+
+/* Checks whether SLOT is held by zswap rather than the swap device. */
+bool zswap_contains(size_t slot)
+{
+    return arena != NULL && entries[slot].unit != 0;
+}
+
+/* Forgets SLOT's contents, because the slot was freed or rewritten. */
+void zswap_invalidate(size_t slot)
+{
+    if (arena == NULL)
+        return;
+
+    lock_acquire(&zswap_lock);
+    entry_free(slot);
+    lock_release(&zswap_lock);
+}
+
+/* Prints compressed swap statistics. */
+void zswap_print_stats(void)
+{
+    if (arena == NULL)
+        return;
+
+    unsigned long long ratio = packed_bytes != 0 ? raw_bytes * 100 / packed_bytes : 0;
+    printf("Zswap: %llu pages stored, %llu incompressible, %llu arena full, "
+           "%llu of %llu swap-ins hit\n",
+           store_cnt, reject_cnt, full_cnt, hit_cnt, lookup_cnt);
+    printf("Zswap: compression ratio %llu.%02llu, %llu kcycles compressing, "
+           "%llu kcycles decompressing\n",
+           ratio / 100, ratio % 100, compress_cycles / 1000, decompress_cycles / 1000);
+}